@@ -1,6 +1,3 @@
-
-#pragma once
-
 #include "stdafx.h"
 
 #include <iostream>
@@ -13,6 +10,24 @@
 
 #include <boost/array.hpp>
 
+#include <algorithm>
+
+#include <chrono>
+
+#include <ctime>
+
+#include <memory>
+
+#include <mutex>
+
+#include <random>
+
+#include <sstream>
+
+#include <thread>
+
+#include <vector>
+
 #include "basic_skills.h"
 
 
@@ -246,25 +261,726 @@ public:
 
 void timer_example_5()
 {
-    // io_context::run() will be called from two threads: main thread and another thread t
+    // io_context::run() will be called from two threads of an IoContextPool (see io_context_pool.h),
+    // named printer5-0 and printer5-1 and pinned to cpus 0 and 1, so they do not migrate between cores
     boost::asio::io_context io;
 
     Printer5 p(io);
 
-    // call io.run() in thread t
+    IoContextPoolOptions options;
+    options.threads = 2;
+    options.cpus.push_back(0);
+    options.cpus.push_back(1 % logical_cpu_count());
+    options.name = "printer5";
+
+    IoContextPool pool(io, options);
+    pool.start();
+    std::cout << "[main thread] pool started, both pool threads call io.run()" << std::endl;
+
+    // join() returns once both timers stopped re-arming themselves and io.run() returned in both threads
+    pool.join();
+    std::cout << "[main thread] pool.join() returned" << std::endl;
+    // note: the first main thread std::cout may race with Printer5 's std::cout printing
+}
+
+
+
+
+
+// Timer Example 6 : many deadlines on one timing wheel
+
+// one steady_timer per deadline puts every deadline into Asio's timer queue (a heap, O(log n) per operation);
+// with hundreds of thousands of idle / heartbeat deadlines, TimingWheel keeps them in O(1) slots instead
+// and drives all of them with a single steady_timer; WheelTimer is used exactly like steady_timer
+
+class WheelPrinter {
+
+private:
+    WheelTimer    timer_;
+    int           count_;
+
+public:
+    WheelPrinter(TimingWheel& wheel) :
+        timer_(wheel),
+        count_(0)
+    {
+        timer_.expires_after(boost::asio::chrono::seconds(1));
+        timer_.async_wait(boost::bind(&WheelPrinter::print, this, boost::asio::placeholders::error));
+    }
+
+    ~WheelPrinter()
+    {
+        std::cout << "[destructor ~WheelPrinter()] Final count is " << count_ << std::endl;
+    }
+
+    void print(const boost::system::error_code& e)
+    {
+        if (!e && count_ < 5)
+        {
+            std::cout << count_ << std::endl;
+            ++count_;
+
+            timer_.expires_at(timer_.expiry() + boost::asio::chrono::seconds(1));
+            timer_.async_wait(boost::bind(&WheelPrinter::print, this, boost::asio::placeholders::error));
+        }
+    }
+};
+
+void timer_example_6()
+{
+    boost::asio::io_context io;
+    TimingWheel wheel(io, boost::asio::chrono::milliseconds(10));
+    WheelPrinter p(wheel);
+    io.run();
+    std::cout << "io.run() has returned, end of timer_example_6()" << std::endl;
+}
+
+
+
+
+// Timer benchmark : steady_timer vs TimingWheel at 10k, 100k and 1M timers
+
+// each round arms every timer with a random deadline between 0.5 s and 1.5 s (arm),
+// then moves every deadline once more, the way an idle timeout is pushed back on activity (re-arm),
+// and finally runs the io_context until all timers have fired (fire: CPU time, worst lateness)
+
+struct TimerBenchmarkStats {
+    size_t    fired;
+    double    maxLatenessMs;
+};
+
+template <typename Timer>
+void on_benchmark_timer(const boost::system::error_code& e, Timer* timer, TimerBenchmarkStats* stats)
+{
+    if (e) {
+        // operation_aborted from a re-arm
+        return;
+    }
+    ++stats->fired;
+
+    std::chrono::duration<double, std::milli> lateness = std::chrono::steady_clock::now() - timer->expiry();
+    stats->maxLatenessMs = std::max(stats->maxLatenessMs, lateness.count());
+}
+
+template <typename Timer>
+double arm_benchmark_timers(std::vector<std::unique_ptr<Timer> >& timers,
+                            const std::vector<std::chrono::milliseconds>& delays,
+                            TimerBenchmarkStats* stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < timers.size(); ++i) {
+        Timer* timer = timers[i].get();
+        timer->expires_after(delays[i]);
+        timer->async_wait(boost::bind(&on_benchmark_timer<Timer>, boost::asio::placeholders::error, timer, stats));
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / timers.size();
+}
+
+template <typename Timer, typename Owner>
+void run_timer_benchmark_round(const char* name, Owner& owner, boost::asio::io_context& io, size_t count)
+{
+    std::vector<std::unique_ptr<Timer> > timers;
+    timers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        timers.push_back(std::unique_ptr<Timer>(new Timer(owner)));
+    }
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> delay(500, 1500);
+    std::vector<std::chrono::milliseconds> firstDelays(count);
+    std::vector<std::chrono::milliseconds> secondDelays(count);
+    for (size_t i = 0; i < count; ++i) {
+        firstDelays[i] = std::chrono::milliseconds(delay(random));
+        secondDelays[i] = std::chrono::milliseconds(delay(random));
+    }
+
+    TimerBenchmarkStats stats = { 0, 0 };
+
+    double armNs = arm_benchmark_timers(timers, firstDelays, &stats);
+    double rearmNs = arm_benchmark_timers(timers, secondDelays, &stats);
+
+    std::clock_t cpuStart = std::clock();
+    io.run();
+    double fireCpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    io.restart();
+
+    std::cout << count << ", " << name << ", " << armNs << ", " << rearmNs << ", "
+              << fireCpuMs << ", " << stats.maxLatenessMs
+              << (stats.fired == count ? "" : "  (not all timers fired!)") << std::endl;
+}
+
+void timer_benchmark()
+{
+    std::cout << "timers, timer, arm (ns/timer), re-arm (ns/timer), fire (CPU ms), max lateness (ms)" << std::endl;
+
+    const size_t counts[] = { 10000, 100000, 1000000 };
+
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        {
+            boost::asio::io_context io;
+            run_timer_benchmark_round<boost::asio::steady_timer>("steady_timer", io, io, counts[i]);
+        }
+        {
+            boost::asio::io_context io;
+            TimingWheel wheel(io, boost::asio::chrono::milliseconds(1));
+            run_timer_benchmark_round<WheelTimer>("TimingWheel", wheel, io, counts[i]);
+        }
+    }
+}
+
+
+
+
+
+// Timer Example 7 : sharing a counter between threads without a strand
+
+// Printer5 sends print1() and print2() through one strand only to protect count_ and std::cout,
+// so with many threads calling io.run() all of its handlers still run one at a time;
+// ShardedPrinter lets its handlers run concurrently: count_ is a ShardedCounter (every thread adds to
+// its own cache line, reads add all slots up) and every line is written to std::cout with a single call
+
+class ShardedPrinter
+{
+
+private:
+    boost::asio::steady_timer           timer1_;
+    boost::asio::steady_timer           timer2_;
+    ShardedCounter                      count_;
+
+    // without a strand both handlers may read the same count at the same time,
+    // so the limit is approximate: the total can overshoot 10 by one
+    void print(const char* name, boost::asio::steady_timer& timer, void (ShardedPrinter::*self)())
+    {
+        uint64_t count = count_.value();
+        if (count < 10)
+        {
+            std::ostringstream line;
+            line << name << ": " << count << "\n";
+            std::cout << line.str() << std::flush;
+
+            count_.add(1);
+
+            timer.expires_at(timer.expiry() + boost::asio::chrono::seconds(1));
+            timer.async_wait(boost::bind(self, this));
+        }
+    }
+
+public:
+    ShardedPrinter(boost::asio::io_context& io) :
+        timer1_(io, boost::asio::chrono::seconds(1)),
+        timer2_(io, boost::asio::chrono::seconds(1))
+    {
+        // no bind_executor(strand_, ...): the handlers may run at the same time on different threads
+        timer1_.async_wait(boost::bind(&ShardedPrinter::print1, this));
+        timer2_.async_wait(boost::bind(&ShardedPrinter::print2, this));
+    }
+
+    ~ShardedPrinter()
+    {
+        std::cout << "[destructor ~ShardedPrinter()] Final count is " << count_.value() << std::endl;
+    }
+
+    void print1()
+    {
+        print("Timer 1", timer1_, &ShardedPrinter::print1);
+    }
+
+    void print2()
+    {
+        print("Timer 2", timer2_, &ShardedPrinter::print2);
+    }
+};
+
+void timer_example_7()
+{
+    boost::asio::io_context io;
+
+    ShardedPrinter p(io);
+
     boost::thread t(boost::bind(&boost::asio::io_context::run, &io));
-    std::cout << "[main thread] thread t starts to run, thread t calls io.run()" << std::endl;
+    io.run();
+    t.join();
+}
+
+
+
+
+// Counter benchmark : strand vs mutex vs sharded counter
+
+// the same number of handlers is posted for every variant, each does a little work of its own and then
+// counts, and 1, 2, 4, 8 and 16 threads call io.run(); like Printer5, the strand variant runs whole handlers
+// one at a time, the mutex variant only serializes the increment on one lock, and the sharded variant
+// lets handlers run without touching a shared cache line at all
+
+struct CounterBenchmarkTargets {
+    uint64_t                            plainCount;     // only touched through the strand
+    std::mutex                          mutex;
+    uint64_t                            lockedCount;    // only touched while holding mutex
+    ShardedCounter                      shardedCount;
+};
+
+// stands in for the real work of a handler (formatting a line, parsing a message)
+uint64_t simulated_handler_work()
+{
+    uint64_t x = 88172645463325252ULL;
+    for (int i = 0; i < 64; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    return x;
+}
+
+void count_on_strand(CounterBenchmarkTargets* targets)
+{
+    targets->plainCount += simulated_handler_work() ? 1 : 0;
+}
+
+void count_with_mutex(CounterBenchmarkTargets* targets)
+{
+    uint64_t increment = simulated_handler_work() ? 1 : 0;
+    std::lock_guard<std::mutex> lock(targets->mutex);
+    targets->lockedCount += increment;
+}
+
+void count_sharded(CounterBenchmarkTargets* targets)
+{
+    targets->shardedCount.add(simulated_handler_work() ? 1 : 0);
+}
+
+double run_counter_benchmark_round(int variant, unsigned int threads, size_t handlers, CounterBenchmarkTargets* targets)
+{
+    boost::asio::io_context io;
+    boost::asio::io_context::strand strand(io);
+
+    for (size_t i = 0; i < handlers; ++i) {
+        switch (variant) {
+        case 0:
+            boost::asio::post(strand, boost::bind(&count_on_strand, targets));
+            break;
+        case 1:
+            boost::asio::post(io, boost::bind(&count_with_mutex, targets));
+            break;
+        default:
+            boost::asio::post(io, boost::bind(&count_sharded, targets));
+            break;
+        }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    boost::thread_group group;
+    for (unsigned int i = 1; i < threads; ++i) {
+        group.create_thread(boost::bind(&boost::asio::io_context::run, &io));
+    }
+    io.run();
+    group.join_all();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return handlers / elapsed.count();
+}
+
+void counter_contention_benchmark()
+{
+    const size_t handlers = 1000000;
+    const char* names[] = { "strand", "mutex", "sharded" };
+
+    std::cout << "threads, variant, handlers/sec" << std::endl;
+
+    for (unsigned int threads = 1; threads <= 16; threads *= 2) {
+        for (int variant = 0; variant < 3; ++variant) {
+            CounterBenchmarkTargets targets;
+            targets.plainCount = 0;
+            targets.lockedCount = 0;
+
+            double handlersPerSecond = run_counter_benchmark_round(variant, threads, handlers, &targets);
+
+            uint64_t counted = targets.plainCount + targets.lockedCount + targets.shardedCount.value();
+            std::cout << threads << ", " << names[variant] << ", " << handlersPerSecond
+                      << (counted == handlers ? "" : "  (lost counts!)") << std::endl;
+        }
+    }
+}
+
+
+
+
+// Timer example 8 : periodic task with a catch-up policy
+
+// print3 and Printer re-arm themselves with expires_at(expiry() + 1s), which does not drift, but nothing
+// says how late each firing was or what should happen after a stall; PeriodicTask schedules tick n at
+// start + n * period, records the lateness of every run and applies a CatchUpPolicy when ticks were missed
+// (here the second heartbeat blocks the thread for 2.5 seconds, so ticks 3 and 4 are due at once)
+
+class HeartbeatPrinter
+{
+
+private:
+    PeriodicTask    task_;
+
+    void beat(const PeriodicTask::Tick& tick)
+    {
+        std::cout << "Heartbeat " << tick.index << " (" << tick.ticks << " tick(s), "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(tick.lateness).count() << " ms late)" << std::endl;
+
+        if (tick.index == 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        }
+        if (tick.index >= 6) {
+            task_.stop();
+        }
+    }
+
+public:
+    HeartbeatPrinter(boost::asio::io_context& io, CatchUpPolicy policy) :
+        task_(io, std::chrono::seconds(1), boost::bind(&HeartbeatPrinter::beat, this, _1), policy)
+    {
+        task_.start();
+    }
+
+    ~HeartbeatPrinter()
+    {
+        std::cout << "[destructor ~HeartbeatPrinter()] runs=" << task_.runs() << " skipped=" << task_.skipped() << " lateness ";
+        task_.lateness().print_summary(std::cout);
+        std::cout << std::endl;
+    }
+};
+
+void timer_example_8()
+{
+    boost::asio::io_context io;
+
+    HeartbeatPrinter p(io, catch_up_coalesce);
 
-    // call io.run() in main thread
-    std::cout << "[main thread] main thread also calls io.run()..." << std::endl;
     io.run();
-    std::cout << "[main thread] main thread io.run() returned" << std::endl;
+}
+
+
+
+
+// Periodic task jitter report : lateness of a 10 ms task under each catch-up policy
+
+// every round runs one task for 2 seconds (ticks 1 .. 200) with a 35 ms stall injected at ticks 50, 100 and
+// 150, so each policy has to deal with a few missed ticks three times; lateness is recorded by PeriodicTask itself
+
+struct JitterRound {
+    PeriodicTask*       task;
+    uint64_t            maxTicks;
+};
+
+void jitter_task(JitterRound* round, const PeriodicTask::Tick& tick)
+{
+    round->maxTicks = std::max(round->maxTicks, tick.ticks);
+
+    // not at tick 200: the task stops there, so no tick after it could be late
+    if (tick.index % 50 == 0 && tick.index < 200) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(35));
+    }
+    if (tick.index >= 200) {
+        round->task->stop();
+    }
+}
+
+void periodic_task_jitter_report()
+{
+    const CatchUpPolicy policies[] = { catch_up_fire_all, catch_up_skip, catch_up_coalesce };
+    const char* names[] = { "fire_all", "skip", "coalesce" };
+
+    std::cout << "policy, runs, skipped, max ticks per run, p50 us, p99 us, max us" << std::endl;
+
+    for (int i = 0; i < 3; ++i) {
+        boost::asio::io_context io;
+
+        JitterRound round = { 0, 0 };
+        PeriodicTask task(io, std::chrono::milliseconds(10), boost::bind(&jitter_task, &round, _1), policies[i]);
+        round.task = &task;
+
+        task.start();
+        io.run();
+
+        const LatencyHistogram& lateness = task.lateness();
+        std::cout << names[i] << ", " << task.runs() << ", " << task.skipped() << ", " << round.maxTicks << ", "
+                  << lateness.percentile(0.50) / 1000.0 << ", " << lateness.percentile(0.99) / 1000.0 << ", "
+                  << lateness.max() / 1000.0 << std::endl;
+    }
+}
+
+
+
+
+
+// Pool timer latency benchmark : how late a timer handler starts, in each IoContextPool run mode
+
+// one pool thread fires a chain of 2000 timers, every handler arms the next one 20 us .. 1 ms ahead, so the
+// thread is idle for a random while before each fire: a blocked thread has to be woken up by the kernel,
+// a spinning one only has to notice the expiry, as long as the gap fits into its spin budget;
+// the price is the CPU time the spinning burns, reported per second of wall time
+
+struct PoolLatencyRound {
+    boost::asio::steady_timer*            timer;
+    LatencyHistogram                      lateness;
+    std::mt19937                          random;
+    std::uniform_int_distribution<int>    gapUs;
+    int                                   remaining;
+
+    PoolLatencyRound(boost::asio::steady_timer* t, int fires) :
+        timer(t),
+        random(42),
+        gapUs(20, 1000),
+        remaining(fires)
+    {
+    }
+};
+
+void on_pool_latency_timer(PoolLatencyRound* round, const boost::system::error_code& e)
+{
+    if (e) {
+        return;
+    }
+    std::chrono::nanoseconds lateness = std::chrono::steady_clock::now() - round->timer->expiry();
+    round->lateness.record(static_cast<uint64_t>(std::max(lateness.count(), std::chrono::nanoseconds::rep(0))));
+
+    if (--round->remaining > 0) {
+        round->timer->expires_after(std::chrono::microseconds(round->gapUs(round->random)));
+        round->timer->async_wait(boost::bind(&on_pool_latency_timer, round, boost::asio::placeholders::error));
+    }
+}
+
+void pool_timer_latency_benchmark()
+{
+    struct Mode {
+        const char*                         name;
+        IoRunMode                           mode;
+        IoContextPoolOptions::duration      spinBudget;
+    };
+    const Mode modes[] = {
+        { "run()",                  io_run_blocking,        IoContextPoolOptions::duration::zero() },
+        { "spin 100 us then block", io_run_spin_then_block, std::chrono::microseconds(100) },
+        { "spin 1 ms then block",   io_run_spin_then_block, std::chrono::milliseconds(1) },
+        { "spin forever",           io_run_spin_then_block, IoContextPoolOptions::spin_forever() }
+    };
+
+    std::cout << "mode, fires, p50 us, p99 us, p99.9 us, max us, CPU ms per s" << std::endl;
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        boost::asio::io_context io;
+        boost::asio::steady_timer timer(io);
+        PoolLatencyRound round(&timer, 2000);
+
+        IoContextPoolOptions options;
+        options.cpus.push_back(logical_cpu_count() - 1);
+        options.mode = modes[i].mode;
+        options.spinBudget = modes[i].spinBudget;
+        options.name = "latency";
+
+        timer.expires_after(std::chrono::microseconds(round.gapUs(round.random)));
+        timer.async_wait(boost::bind(&on_pool_latency_timer, &round, boost::asio::placeholders::error));
+
+        IoContextPool pool(io, options);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::clock_t cpuStart = std::clock();
+        pool.start();
+        pool.join();
+        double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const LatencyHistogram& lateness = round.lateness;
+        std::cout << modes[i].name << ", " << lateness.count() << ", "
+                  << lateness.percentile(0.50) / 1000.0 << ", " << lateness.percentile(0.99) / 1000.0 << ", "
+                  << lateness.percentile(0.999) / 1000.0 << ", " << lateness.max() / 1000.0 << ", "
+                  << cpuMs / elapsed.count()
+                  << (pool.unpinned_threads() == 0 ? "" : "  (could not pin the pool thread)") << std::endl;
+    }
+}
 
+
+
+
+
+// Timer example 9 : the repeating timers of examples 3 and 5 as C++20 coroutines
+
+// print3 has to be handed the timer and the counter through boost::bind, and Printer5 keeps them as members
+// so that its handlers can find them again; a coroutine keeps them as local variables instead, and the loop
+// reads top to bottom: co_await suspends until the timer fires, with no handler object to allocate and no
+// object lifetime to think about (the timer lives exactly as long as the coroutine)
+// two coroutines on one strand, so their output does not interleave even when io.run() runs on two threads
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+boost::asio::awaitable<void> count_with_timer(const char* name, int* sharedCount)
+{
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+
+    for (int i = 0; i < 5; ++i) {
+        timer.expires_after(boost::asio::chrono::seconds(1));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+
+        std::cout << name << ": " << *sharedCount << std::endl;
+        ++(*sharedCount);
+    }
+}
+
+void timer_example_9()
+{
+    boost::asio::io_context io;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand(io.get_executor());
+
+    int count = 0;
+    boost::asio::co_spawn(strand, count_with_timer("Timer 1", &count), boost::asio::detached);
+    boost::asio::co_spawn(strand, count_with_timer("Timer 2", &count), boost::asio::detached);
+
+    boost::thread t(boost::bind(&boost::asio::io_context::run, &io));
+    io.run();
     t.join();
-    std::cout << "[main thread] t.join() returned" << std::endl;
-    // note: these main thread std::cout may race with Printer5 's std::cout printing
+
+    std::cout << "io.run() has returned, final count is " << count << ", end of timer_example_9()" << std::endl;
 }
 
+#endif
+
+
+
+
+
+
+
+
+// Timing wheel check : handlers that cancel, re-arm and destroy other timers of the same tick
+
+// all timers below are due in the same tick, so they sit in the same slot; the slot is a list with the
+// most recently armed timer first, so canceller_ fires first and then, from its handler, cancels one
+// sibling, re-arms another one and destroys a third, all of them still linked behind it in that slot;
+// the untouched sibling must still fire, the cancelled one must see operation_aborted, the re-armed one
+// must fire once, later, and the wheel must end up empty
+
+struct WheelSiblingResults {
+    int    untouchedFired;
+    int    cancelledAborted;
+    int    cancelledFired;
+    int    rearmedFired;
+    int    destroyedCalled;
+};
+
+void on_wheel_sibling(int* fired, int* aborted, const boost::system::error_code& e)
+{
+    ++*(e ? aborted : fired);
+}
+
+class WheelSiblingCanceller {
+private:
+    WheelTimer&                    cancelled_;
+    WheelTimer&                    rearmed_;
+    std::unique_ptr<WheelTimer>&   destroyed_;
+    WheelSiblingResults&           results_;
+
+public:
+    WheelSiblingCanceller(WheelTimer& cancelled, WheelTimer& rearmed, std::unique_ptr<WheelTimer>& destroyed,
+                          WheelSiblingResults& results) :
+        cancelled_(cancelled),
+        rearmed_(rearmed),
+        destroyed_(destroyed),
+        results_(results)
+    {
+    }
+
+    void fire(const boost::system::error_code& e)
+    {
+        if (e) {
+            return;
+        }
+        cancelled_.cancel();
+
+        rearmed_.expires_after(boost::asio::chrono::milliseconds(5));
+        rearmed_.async_wait(boost::bind(&on_wheel_sibling, &results_.rearmedFired, &results_.rearmedFired,
+                                        boost::asio::placeholders::error));
+
+        destroyed_.reset();
+    }
+};
+
+// a handler that runs longer than a tick and re-arms its timer 256 ticks after its last expiry: the wheel
+// is empty while it runs (the timer was the only one), so the re-arm must not move the wheel's current
+// tick on under the slot being processed; the timer must fire 3 times and the run must end by itself
+
+struct WheelSlowRearm {
+    WheelTimer*    timer;
+    int            fired;
+
+    void fire(const boost::system::error_code& e)
+    {
+        if (e) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        if (++fired < 3) {
+            timer->expires_at(timer->expiry() + std::chrono::milliseconds(256));
+            timer->async_wait(boost::bind(&WheelSlowRearm::fire, this, boost::asio::placeholders::error));
+        }
+    }
+};
+
+bool timing_wheel_slow_rearm_check()
+{
+    boost::asio::io_context io;
+    TimingWheel wheel(io, boost::asio::chrono::milliseconds(1));
+    WheelTimer timer(wheel);
+    WheelSlowRearm rearm = { &timer, 0 };
+
+    timer.expires_after(boost::asio::chrono::milliseconds(5));
+    timer.async_wait(boost::bind(&WheelSlowRearm::fire, &rearm, boost::asio::placeholders::error));
+
+    // if the wheel were stuck, the test would hang in the handler and ctest's timeout would fail it
+    io.run();
+
+    bool passed = rearm.fired == 3 && wheel.size() == 0;
+    std::cout << "[timing wheel check] slow handler re-arming 256 ticks ahead: fired " << rearm.fired
+              << ", left armed " << wheel.size() << ": " << (passed ? "ok" : "FAILED") << std::endl;
+    return passed;
+}
+
+bool timing_wheel_check()
+{
+    boost::asio::io_context io;
+    TimingWheel wheel(io, boost::asio::chrono::milliseconds(1));
+    WheelSiblingResults results = { 0, 0, 0, 0, 0 };
+    int ignored = 0;
+
+    WheelTimer untouched(wheel);
+    WheelTimer cancelled(wheel);
+    WheelTimer rearmed(wheel);
+    std::unique_ptr<WheelTimer> destroyed(new WheelTimer(wheel));
+    WheelTimer canceller(wheel);
+    WheelSiblingCanceller cancellerHandler(cancelled, rearmed, destroyed, results);
+
+    // one expiry for all of them, armed in reverse firing order
+    WheelTimer::time_point expiry = WheelTimer::clock_type::now() + boost::asio::chrono::milliseconds(20);
+    untouched.expires_at(expiry);
+    untouched.async_wait(boost::bind(&on_wheel_sibling, &results.untouchedFired, &ignored, boost::asio::placeholders::error));
+    cancelled.expires_at(expiry);
+    cancelled.async_wait(boost::bind(&on_wheel_sibling, &results.cancelledFired, &results.cancelledAborted,
+                                     boost::asio::placeholders::error));
+    rearmed.expires_at(expiry);
+    rearmed.async_wait(boost::bind(&on_wheel_sibling, &ignored, &ignored, boost::asio::placeholders::error));
+    destroyed->expires_at(expiry);
+    destroyed->async_wait(boost::bind(&on_wheel_sibling, &results.destroyedCalled, &ignored, boost::asio::placeholders::error));
+    canceller.expires_at(expiry);
+    canceller.async_wait(boost::bind(&WheelSiblingCanceller::fire, &cancellerHandler, boost::asio::placeholders::error));
+
+    io.run();
+
+    bool passed = results.untouchedFired == 1 && results.cancelledAborted == 1 && results.cancelledFired == 0
+                  && results.rearmedFired == 1 && results.destroyedCalled == 0 && wheel.size() == 0;
+    std::cout << "[timing wheel check] same-tick cancel / re-arm / destroy: untouched fired " << results.untouchedFired
+              << ", cancelled aborted " << results.cancelledAborted << " fired " << results.cancelledFired
+              << ", re-armed fired " << results.rearmedFired << ", destroyed fired " << results.destroyedCalled
+              << ", left armed " << wheel.size() << ": " << (passed ? "ok" : "FAILED") << std::endl;
+    return timing_wheel_slow_rearm_check() && passed;
+}
+
+
 
 
 
@@ -278,4 +994,25 @@ void learn_basic_skills()
     timer_example_3();
     timer_example_4();
     timer_example_5();
+    timer_example_6();
+    timer_example_7();
+    timer_example_8();
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+    timer_example_9();
+#endif
+}
+
+void run_basic_skills_benchmarks()
+{
+    timer_benchmark();
+    counter_contention_benchmark();
+    periodic_task_jitter_report();
+    pool_timer_latency_benchmark();
+}
+
+bool run_basic_skills_checks()
+{
+    bool passed = timing_wheel_check();
+    std::cout << "[basic skills checks] " << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed;
 }
\ No newline at end of file
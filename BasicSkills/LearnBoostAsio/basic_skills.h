@@ -5,6 +5,11 @@
 #include <boost/thread/thread.hpp>
 #include <boost/array.hpp>
 
+#include "timing_wheel.h"
+#include "sharded_counter.h"
+#include "periodic_task.h"
+#include "io_context_pool.h"
+
 // declare all functions and classes used in basic_skills.cpp
 // refer to basic_skills.cpp to learn details
 
@@ -29,4 +34,36 @@ class Printer5;
 
 void timer_example_5();
 
-void learn_basic_skills();
\ No newline at end of file
+class WheelPrinter;
+
+void timer_example_6();
+
+void timer_benchmark();
+
+class ShardedPrinter;
+
+void timer_example_7();
+
+void counter_contention_benchmark();
+
+class HeartbeatPrinter;
+
+void timer_example_8();
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+boost::asio::awaitable<void> count_with_timer(const char* name, int* sharedCount);
+
+void timer_example_9();
+#endif
+
+void periodic_task_jitter_report();
+
+void pool_timer_latency_benchmark();
+
+bool timing_wheel_check();
+
+void learn_basic_skills();
+
+void run_basic_skills_benchmarks();
+
+bool run_basic_skills_checks();
\ No newline at end of file
@@ -0,0 +1,485 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+
+// hierarchical timing wheel: a cheap alternative to one steady_timer per deadline
+// when there are hundreds of thousands of them (idle timeouts, heartbeats)
+
+// time is cut into ticks (1 ms by default); a timer lands in one of 4 levels of 256 slots,
+// level n holding the timers that expire within 256^(n+1) ticks;
+// every 256^n ticks one slot of level n is cascaded down a level, so arming and cancelling are O(1)
+// (link into / unlink from a doubly linked slot list) and expiring costs O(1) per timer;
+// the whole wheel is driven by a single steady_timer, which only runs while timers are armed
+
+// like steady_timer, a TimingWheel and its WheelTimers must only be used from the thread
+// running their io_context (or through one strand)
+
+class TimingWheel;
+
+
+// type-erased void(const boost::system::error_code&) handler,
+// stored inline when small enough so that arming a timer does not allocate
+class WheelHandler : private boost::noncopyable {
+private:
+    enum {
+        inline_size = 64
+    };
+
+    typedef void (*InvokeFunction)(void* handler, const boost::system::error_code& errorCode);
+    typedef void (*DestroyFunction)(void* handler);
+    typedef void* (*RelocateFunction)(void* handler, void* storage);
+
+    union Storage {
+        std::max_align_t    alignment;
+        unsigned char       bytes[inline_size];
+    };
+
+    Storage             storage_;
+    void*               handler_;
+    InvokeFunction      invoke_;
+    DestroyFunction     destroy_;
+    RelocateFunction    relocate_;
+
+    template <typename Handler>
+    struct Functions {
+        static void invoke(void* handler, const boost::system::error_code& errorCode)
+        {
+            (*static_cast<Handler*>(handler))(errorCode);
+        }
+
+        static void destroy_inline(void* handler)
+        {
+            static_cast<Handler*>(handler)->~Handler();
+        }
+
+        static void destroy_heap(void* handler)
+        {
+            delete static_cast<Handler*>(handler);
+        }
+
+        // move an inline handler into another storage, returns its new address
+        static void* relocate_inline(void* handler, void* storage)
+        {
+            Handler* moved = new (storage) Handler(std::move(*static_cast<Handler*>(handler)));
+            static_cast<Handler*>(handler)->~Handler();
+            return moved;
+        }
+
+        // a heap handler just changes owner
+        static void* relocate_heap(void* handler, void* /*storage*/)
+        {
+            return handler;
+        }
+    };
+
+public:
+    WheelHandler() :
+        handler_(0),
+        invoke_(0),
+        destroy_(0),
+        relocate_(0)
+    {
+    }
+
+    // movable (but not copyable), so that a cancelled handler can be posted by value
+    WheelHandler(WheelHandler&& other) :
+        handler_(0),
+        invoke_(0),
+        destroy_(0),
+        relocate_(0)
+    {
+        take(other);
+    }
+
+    ~WheelHandler()
+    {
+        reset();
+    }
+
+    bool empty() const
+    {
+        return handler_ == 0;
+    }
+
+    template <typename Handler>
+    void assign(const Handler& handler)
+    {
+        reset();
+        if (sizeof(Handler) <= sizeof(storage_) && alignof(Handler) <= alignof(Storage)) {
+            handler_ = new (storage_.bytes) Handler(handler);
+            destroy_ = &Functions<Handler>::destroy_inline;
+            relocate_ = &Functions<Handler>::relocate_inline;
+        }
+        else {
+            handler_ = new Handler(handler);
+            destroy_ = &Functions<Handler>::destroy_heap;
+            relocate_ = &Functions<Handler>::relocate_heap;
+        }
+        invoke_ = &Functions<Handler>::invoke;
+    }
+
+    void reset()
+    {
+        if (handler_) {
+            destroy_(handler_);
+            handler_ = 0;
+        }
+    }
+
+    // take over other's handler, other is left empty
+    void take(WheelHandler& other)
+    {
+        reset();
+        if (!other.handler_) {
+            return;
+        }
+        handler_ = other.relocate_(other.handler_, storage_.bytes);
+        invoke_ = other.invoke_;
+        destroy_ = other.destroy_;
+        relocate_ = other.relocate_;
+        other.handler_ = 0;
+    }
+
+    // moves the handler out before calling it, so that it may re-arm its own timer
+    void invoke_and_reset(const boost::system::error_code& errorCode)
+    {
+        WheelHandler handler;
+        handler.take(*this);
+        handler.invoke_(handler.handler_, errorCode);
+    }
+};
+
+
+// one deadline; same interface as steady_timer for the parts the examples use
+class WheelTimer : private boost::noncopyable {
+public:
+    typedef std::chrono::steady_clock       clock_type;
+    typedef clock_type::duration            duration;
+    typedef clock_type::time_point          time_point;
+
+private:
+    friend class TimingWheel;
+
+    TimingWheel&     wheel_;
+    WheelTimer*      prev_;
+    WheelTimer*      next_;
+    WheelTimer**     slot_;         // head pointer of the slot list this timer is linked into, 0 if idle
+    uint64_t         expiryTick_;
+    time_point       expiry_;
+    WheelHandler     handler_;
+
+public:
+    explicit WheelTimer(TimingWheel& wheel);
+
+    ~WheelTimer();
+
+    time_point expiry() const
+    {
+        return expiry_;
+    }
+
+    // both cancel a pending wait, like steady_timer; they return the number of cancelled waits
+    size_t expires_at(time_point expiry);
+
+    size_t expires_after(duration delay)
+    {
+        return expires_at(clock_type::now() + delay);
+    }
+
+    template <typename Handler>
+    void async_wait(const Handler& handler);
+
+    // the pending wait, if any, completes with boost::asio::error::operation_aborted
+    size_t cancel();
+};
+
+
+class TimingWheel : private boost::noncopyable {
+public:
+    typedef WheelTimer::clock_type      clock_type;
+    typedef WheelTimer::duration        duration;
+    typedef WheelTimer::time_point      time_point;
+
+private:
+    friend class WheelTimer;
+
+    enum {
+        slot_bits  = 8,
+        slots      = 1 << slot_bits,
+        slot_mask  = slots - 1,
+        levels     = 4
+    };
+
+    boost::asio::io_context&        io_context_;
+    boost::asio::steady_timer       timer_;         // the one OS-level timer of the wheel
+    duration                        tick_;
+    time_point                      start_;
+    uint64_t                        currentTick_;   // every tick up to and including this one has been processed
+    size_t                          armed_;
+    bool                            timerRunning_;
+    bool                            advancing_;     // handle_tick() is processing ticks (and calling handlers)
+    WheelTimer*                     slots_[levels][slots];
+
+    uint64_t now_tick() const
+    {
+        return static_cast<uint64_t>((clock_type::now() - start_) / tick_);
+    }
+
+    uint64_t tick_for(time_point expiry) const
+    {
+        if (expiry <= start_) {
+            return 0;
+        }
+        // round up: a timer never fires before its expiry time, and at most one tick after it
+        return static_cast<uint64_t>((expiry - start_ + tick_ - duration(1)) / tick_);
+    }
+
+    // expiryTick_ must be >= currentTick_: a timer due at currentTick_ itself is only linked
+    // while cascading, right before the level 0 slot of currentTick_ is processed
+    void link(WheelTimer* timer)
+    {
+        uint64_t delta = timer->expiryTick_ - currentTick_;
+        int level = 0;
+        while (level < levels - 1 && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+            ++level;
+        }
+        // beyond the last level (about 49 days with 1 ms ticks) a timer is parked in the last level
+        // and simply re-linked whenever its slot cascades
+        WheelTimer** slot = &slots_[level][(timer->expiryTick_ >> (slot_bits * level)) & slot_mask];
+
+        timer->slot_ = slot;
+        timer->prev_ = 0;
+        timer->next_ = *slot;
+        if (*slot) {
+            (*slot)->prev_ = timer;
+        }
+        *slot = timer;
+    }
+
+    static void unlink(WheelTimer* timer)
+    {
+        if (timer->prev_) {
+            timer->prev_->next_ = timer->next_;
+        }
+        else {
+            *timer->slot_ = timer->next_;
+        }
+        if (timer->next_) {
+            timer->next_->prev_ = timer->prev_;
+        }
+        timer->prev_ = timer->next_ = 0;
+        timer->slot_ = 0;
+    }
+
+    void cascade(int level)
+    {
+        WheelTimer** slot = &slots_[level][(currentTick_ >> (slot_bits * level)) & slot_mask];
+        WheelTimer* timer = *slot;
+        *slot = 0;
+
+        while (timer) {
+            WheelTimer* next = timer->next_;
+            link(timer);
+            timer = next;
+        }
+    }
+
+    void advance_one_tick()
+    {
+        ++currentTick_;
+
+        // crossing a multiple of 256^level ticks moves the current slot of that level one level down
+        for (int level = 1; level < levels; ++level) {
+            if ((currentTick_ & ((uint64_t(1) << (slot_bits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        // the slot is detached first, so nothing linked while it is processed can land in this list;
+        // its timers are still taken one at a time: a handler may cancel, re-arm or destroy another timer
+        // of the same tick, which unlinks it from the detached list
+        WheelTimer* due = slots_[0][currentTick_ & slot_mask];
+        slots_[0][currentTick_ & slot_mask] = 0;
+        for (WheelTimer* timer = due; timer; timer = timer->next_) {
+            timer->slot_ = &due;
+        }
+
+        while (due) {
+            WheelTimer* timer = due;
+            unlink(timer);
+
+            if (timer->expiryTick_ > currentTick_) {
+                // parked beyond the last level, not due yet
+                link(timer);
+                continue;
+            }
+
+            --armed_;
+            timer->handler_.invoke_and_reset(boost::system::error_code());
+        }
+    }
+
+    void schedule()
+    {
+        if (timerRunning_ || armed_ == 0) {
+            return;
+        }
+        timerRunning_ = true;
+        timer_.expires_at(start_ + tick_ * static_cast<duration::rep>(currentTick_ + 1));
+        timer_.async_wait(boost::bind(&TimingWheel::handle_tick, this, boost::asio::placeholders::error));
+    }
+
+    void handle_tick(const boost::system::error_code& errorCode)
+    {
+        timerRunning_ = false;
+        if (errorCode) {
+            return;
+        }
+
+        // catch up with every tick that has passed, even if this thread was late
+        uint64_t nowTick = now_tick();
+        advancing_ = true;
+        while (currentTick_ < nowTick && armed_ > 0) {
+            advance_one_tick();
+        }
+        advancing_ = false;
+        if (armed_ == 0 && currentTick_ < nowTick) {
+            currentTick_ = nowTick;
+        }
+        schedule();
+    }
+
+    void arm(WheelTimer* timer)
+    {
+        if (armed_ == 0 && !advancing_) {
+            // nothing was armed, so the wheel did not tick while the OS timer was idle;
+            // not from a handler called by advance_one_tick(): the tick being processed stays current
+            uint64_t nowTick = now_tick();
+            if (nowTick > currentTick_) {
+                currentTick_ = nowTick;
+            }
+        }
+        // the slot of currentTick_ has already been processed, so the earliest a new timer can fire is the next tick
+        timer->expiryTick_ = tick_for(timer->expiry_);
+        if (timer->expiryTick_ <= currentTick_) {
+            timer->expiryTick_ = currentTick_ + 1;
+        }
+        link(timer);
+        ++armed_;
+        schedule();
+    }
+
+    bool disarm(WheelTimer* timer)
+    {
+        if (!timer->slot_) {
+            return false;
+        }
+        unlink(timer);
+        --armed_;
+        return true;
+    }
+
+    struct AbortedWait {
+        WheelHandler    handler;
+
+        explicit AbortedWait(WheelHandler& pending)
+        {
+            handler.take(pending);
+        }
+
+        void operator()()
+        {
+            handler.invoke_and_reset(boost::asio::error::operation_aborted);
+        }
+    };
+
+    // like Asio, a cancelled handler is never called from inside cancel(), it is posted
+    void post_aborted(WheelHandler& handler)
+    {
+        boost::asio::post(io_context_, AbortedWait(handler));
+    }
+
+public:
+    explicit TimingWheel(boost::asio::io_context& io_context,
+                         duration tick = std::chrono::milliseconds(1)) :
+        io_context_(io_context),
+        timer_(io_context),
+        tick_(tick),
+        start_(clock_type::now()),
+        currentTick_(0),
+        armed_(0),
+        timerRunning_(false),
+        advancing_(false)
+    {
+        for (int level = 0; level < levels; ++level) {
+            for (int i = 0; i < slots; ++i) {
+                slots_[level][i] = 0;
+            }
+        }
+    }
+
+    boost::asio::io_context& context()
+    {
+        return io_context_;
+    }
+
+    duration tick() const
+    {
+        return tick_;
+    }
+
+    // number of timers currently waiting
+    size_t size() const
+    {
+        return armed_;
+    }
+};
+
+
+inline WheelTimer::WheelTimer(TimingWheel& wheel) :
+    wheel_(wheel),
+    prev_(0),
+    next_(0),
+    slot_(0),
+    expiryTick_(0),
+    expiry_(clock_type::now())
+{
+}
+
+inline WheelTimer::~WheelTimer()
+{
+    cancel();
+}
+
+inline size_t WheelTimer::expires_at(time_point expiry)
+{
+    size_t cancelled = cancel();
+    expiry_ = expiry;
+    return cancelled;
+}
+
+template <typename Handler>
+inline void WheelTimer::async_wait(const Handler& handler)
+{
+    cancel();
+    handler_.assign(handler);
+    wheel_.arm(this);
+}
+
+inline size_t WheelTimer::cancel()
+{
+    if (!wheel_.disarm(this)) {
+        return 0;
+    }
+    wheel_.post_aborted(handler_);
+    return 1;
+}
@@ -0,0 +1,781 @@
+// asio_benchmarks.cpp : microbenchmarks of the Boost.Asio operations the examples are built from
+//
+// prints CSV on stdout, one line per benchmark, so results can be collected and compared between runs:
+//   benchmark,iterations,ns_per_op,p50_ns,p99_ns,max_ns,cpu_ns_per_op,allocs_per_op
+// the percentile columns are 0 for benchmarks that only measure throughput, cpu_ns_per_op is 0 for
+// benchmarks that do not measure the CPU time of a server thread, and allocs_per_op counts every
+// operator new of the process (all threads) while the benchmark runs
+//
+// asio_benchmarks                  run everything
+// asio_benchmarks post timer ...   run only the benchmarks whose name starts with one of the arguments
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono/thread_clock.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "asio_backend.h"
+#include "async_logger.h"
+#include "discard_stream.h"
+#include "gather_response.h"
+#include "heap_allocation_counter.h"
+#include "latency_histogram.h"
+#include "time_formatter.h"
+
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchmarkResult {
+    uint64_t            iterations;
+    double              seconds;
+    double              cpuSeconds;     // CPU time of the server thread, 0 if not measured
+    LatencyHistogram    latency;        // per-operation samples, empty for throughput-only benchmarks
+
+    BenchmarkResult() :
+        iterations(0),
+        seconds(0),
+        cpuSeconds(0)
+    {
+    }
+};
+
+
+typedef void (*BenchmarkFunction)(BenchmarkResult& result);
+
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static uint64_t nanoseconds_since(Clock::time_point start)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+// the work every handler does; kept out of line so a direct call really is a call
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void count_one(uint64_t* counter)
+{
+    ++*counter;
+}
+
+void count_wait(uint64_t* counter, const boost::system::error_code& /*errorCode*/)
+{
+    ++*counter;
+}
+
+
+
+
+// baseline: the handler body called directly (through a function pointer the compiler cannot see through)
+
+void direct_call_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 10000000;
+    uint64_t counter = 0;
+    void (*volatile call)(uint64_t*) = &count_one;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        call(&counter);
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = counter;
+}
+
+
+
+
+// post: queue handlers on an io_context and run them; boost::bind and lambda handlers side by side
+
+void post_bind_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 1000000;
+    boost::asio::io_context io;
+    uint64_t counter = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        boost::asio::post(io, boost::bind(&count_one, &counter));
+    }
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = counter;
+}
+
+void post_lambda_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 1000000;
+    boost::asio::io_context io;
+    uint64_t counter = 0;
+    uint64_t* counterPtr = &counter;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        boost::asio::post(io, [counterPtr]() { count_one(counterPtr); });
+    }
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = counter;
+}
+
+// one handler at a time: every handler posts the next one, so each op is a full queue round trip
+void post_chain_step(boost::asio::io_context* io, uint64_t* remaining)
+{
+    if (--*remaining > 0) {
+        boost::asio::post(*io, boost::bind(&post_chain_step, io, remaining));
+    }
+}
+
+void post_chain_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 1000000;
+    boost::asio::io_context io;
+    uint64_t remaining = iterations;
+
+    Clock::time_point start = Clock::now();
+    boost::asio::post(io, boost::bind(&post_chain_step, &io, &remaining));
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+
+
+
+// dispatch from inside a running handler: runs the handler inline instead of queueing it
+
+void dispatch_many(boost::asio::io_context* io, uint64_t iterations, uint64_t* counter)
+{
+    for (uint64_t i = 0; i < iterations; ++i) {
+        boost::asio::dispatch(*io, boost::bind(&count_one, counter));
+    }
+}
+
+void dispatch_in_handler_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 10000000;
+    boost::asio::io_context io;
+    uint64_t counter = 0;
+
+    Clock::time_point start = Clock::now();
+    boost::asio::post(io, boost::bind(&dispatch_many, &io, iterations, &counter));
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = counter;
+}
+
+
+
+
+// bind_executor(strand, ...): the same posts as post_bind, but every handler goes through a strand
+// (the way Printer5 wraps its timer handlers)
+
+void post_bind_executor_strand_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 1000000;
+    boost::asio::io_context io;
+    boost::asio::io_context::strand strand(io);
+    uint64_t counter = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        boost::asio::post(io, boost::asio::bind_executor(strand, boost::bind(&count_one, &counter)));
+    }
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = counter;
+}
+
+
+
+
+// steady_timer: cost of arming one more pending timer, and how late a short wait actually completes
+
+void steady_timer_arm_benchmark(BenchmarkResult& result)
+{
+    const size_t timerCount = 100000;
+    boost::asio::io_context io;
+    uint64_t counter = 0;
+
+    std::vector<boost::shared_ptr<boost::asio::steady_timer> > timers;
+    timers.reserve(timerCount);
+    for (size_t i = 0; i < timerCount; ++i) {
+        timers.push_back(boost::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(io)));
+    }
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < timerCount; ++i) {
+        timers[i]->expires_after(std::chrono::hours(1) + std::chrono::microseconds(i));
+        timers[i]->async_wait(boost::bind(&count_wait, &counter, boost::asio::placeholders::error));
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = timerCount;
+
+    for (size_t i = 0; i < timerCount; ++i) {
+        timers[i]->cancel();
+    }
+    io.run();
+}
+
+void record_timer_lateness(boost::asio::steady_timer* timer,
+                           LatencyHistogram* latency,
+                           uint64_t* remaining,
+                           const boost::system::error_code& errorCode)
+{
+    if (errorCode) {
+        return;
+    }
+    latency->record(nanoseconds_since(timer->expiry()));
+
+    if (--*remaining > 0) {
+        timer->expires_after(std::chrono::microseconds(500));
+        timer->async_wait(boost::bind(&record_timer_lateness, timer, latency, remaining, boost::asio::placeholders::error));
+    }
+}
+
+void steady_timer_fire_latency_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 2000;
+    boost::asio::io_context io;
+    boost::asio::steady_timer timer(io);
+    uint64_t remaining = iterations;
+
+    Clock::time_point start = Clock::now();
+    timer.expires_after(std::chrono::microseconds(500));
+    timer.async_wait(boost::bind(&record_timer_lateness, &timer, &result.latency, &remaining, boost::asio::placeholders::error));
+    io.run();
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+
+
+
+// loopback accept + write: a daytime-style server (accept, write 26 bytes, close) on its own thread,
+// and a synchronous client doing connect + read until EOF; every round trip is one sample
+// the server is written twice, with boost::bind callbacks and as C++20 coroutines, on the same single-threaded
+// io_context; cpu_ns_per_op is the CPU time of the server thread per connection
+
+// runs io_context on the calling thread and adds the CPU time that thread spent to *cpuSeconds
+void run_measuring_cpu(boost::asio::io_context* io_context, double* cpuSeconds)
+{
+    boost::chrono::thread_clock::time_point start = boost::chrono::thread_clock::now();
+    io_context->run();
+    *cpuSeconds += boost::chrono::duration<double>(boost::chrono::thread_clock::now() - start).count();
+}
+
+class LoopbackDaytimeServer {
+private:
+    typedef boost::asio::ip::tcp tcp;
+
+    boost::asio::io_context    io_context_;
+    tcp::acceptor              acceptor_;
+    std::string                message_;
+    double                     cpuSeconds_;
+    boost::thread              thread_;
+
+    void start_accept()
+    {
+        boost::shared_ptr<tcp::socket> socket(new tcp::socket(io_context_));
+        acceptor_.async_accept(*socket,
+                               boost::bind(&LoopbackDaytimeServer::handle_accept,
+                                           this,
+                                           socket,
+                                           boost::asio::placeholders::error));
+    }
+
+    void handle_accept(boost::shared_ptr<tcp::socket> socket, const boost::system::error_code& errorCode)
+    {
+        if (errorCode) {
+            return;
+        }
+        // the bound shared_ptr keeps the socket alive until the write completes, then it closes
+        boost::asio::async_write(*socket,
+                                 boost::asio::buffer(message_),
+                                 boost::bind(&LoopbackDaytimeServer::handle_write,
+                                             this,
+                                             socket,
+                                             boost::asio::placeholders::error));
+        start_accept();
+    }
+
+    void handle_write(boost::shared_ptr<tcp::socket> /*socket*/, const boost::system::error_code& /*errorCode*/)
+    {
+    }
+
+public:
+    LoopbackDaytimeServer() :
+        acceptor_(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        message_("Thu Oct 17 12:00:00 2024\n"),
+        cpuSeconds_(0)
+    {
+        start_accept();
+        thread_ = boost::thread(boost::bind(&run_measuring_cpu, &io_context_, &cpuSeconds_));
+    }
+
+    ~LoopbackDaytimeServer()
+    {
+        stop();
+    }
+
+    tcp::endpoint endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
+
+    void stop()
+    {
+        io_context_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // valid after stop()
+    double cpu_seconds() const
+    {
+        return cpuSeconds_;
+    }
+};
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+// the same server as coroutines: the socket lives in the frame of its session, no shared_ptr, no bind
+class LoopbackCoroutineDaytimeServer {
+private:
+    typedef boost::asio::ip::tcp tcp;
+
+    boost::asio::io_context    io_context_;
+    tcp::acceptor              acceptor_;
+    std::string                message_;
+    double                     cpuSeconds_;
+    boost::thread              thread_;
+
+    boost::asio::awaitable<void> session(tcp::socket socket)
+    {
+        boost::system::error_code errorCode;
+        co_await boost::asio::async_write(socket,
+                                          boost::asio::buffer(message_),
+                                          boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+    }
+
+    boost::asio::awaitable<void> listen()
+    {
+        for (;;) {
+            boost::system::error_code errorCode;
+            tcp::socket socket = co_await acceptor_.async_accept(boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+            if (errorCode) {
+                co_return;
+            }
+            boost::asio::co_spawn(io_context_, session(std::move(socket)), boost::asio::detached);
+        }
+    }
+
+public:
+    LoopbackCoroutineDaytimeServer() :
+        acceptor_(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        message_("Thu Oct 17 12:00:00 2024\n"),
+        cpuSeconds_(0)
+    {
+        boost::asio::co_spawn(io_context_, listen(), boost::asio::detached);
+        thread_ = boost::thread(boost::bind(&run_measuring_cpu, &io_context_, &cpuSeconds_));
+    }
+
+    ~LoopbackCoroutineDaytimeServer()
+    {
+        stop();
+    }
+
+    tcp::endpoint endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
+
+    void stop()
+    {
+        io_context_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    double cpu_seconds() const
+    {
+        return cpuSeconds_;
+    }
+};
+
+#endif
+
+template <typename Server>
+void run_loopback_accept_write(BenchmarkResult& result)
+{
+    using boost::asio::ip::tcp;
+
+    const uint64_t iterations = 5000;
+    Server server;
+    boost::asio::io_context io;
+    boost::array<char, 128> buf;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        Clock::time_point begin = Clock::now();
+
+        tcp::socket socket(io);
+        socket.connect(server.endpoint());
+
+        boost::system::error_code errorCode;
+        size_t received = 0;
+        while (!errorCode) {
+            received += socket.read_some(boost::asio::buffer(buf), errorCode);
+        }
+        if (errorCode != boost::asio::error::eof || received == 0) {
+            std::cerr << "loopback_accept_write: " << errorCode.message() << std::endl;
+            break;
+        }
+
+        result.latency.record(nanoseconds_since(begin));
+        ++result.iterations;
+    }
+    result.seconds = seconds_since(start);
+
+    server.stop();
+    result.cpuSeconds = server.cpu_seconds();
+}
+
+void loopback_accept_write_benchmark(BenchmarkResult& result)
+{
+    run_loopback_accept_write<LoopbackDaytimeServer>(result);
+}
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+void loopback_accept_write_coroutine_benchmark(BenchmarkResult& result)
+{
+    run_loopback_accept_write<LoopbackCoroutineDaytimeServer>(result);
+}
+#endif
+
+
+
+
+// response assembly: a static header, a shared (cached) segment and a per-request fragment written to a
+// loopback TCP connection, concatenated into a fresh string vs one gather write per response vs 16
+// responses coalesced into one gather write; a reader thread drains the other end
+
+class LoopbackPair {
+private:
+    typedef boost::asio::ip::tcp tcp;
+
+    boost::asio::io_context    io_context_;
+    tcp::socket                writer_;
+    tcp::socket                reader_;
+    boost::thread              readerThread_;
+
+    void drain()
+    {
+        boost::array<char, 65536> buf;
+        boost::system::error_code errorCode;
+        while (!errorCode) {
+            reader_.read_some(boost::asio::buffer(buf), errorCode);
+        }
+    }
+
+public:
+    LoopbackPair() :
+        writer_(io_context_),
+        reader_(io_context_)
+    {
+        tcp::acceptor acceptor(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        writer_.connect(acceptor.local_endpoint());
+        acceptor.accept(reader_);
+        readerThread_ = boost::thread(boost::bind(&LoopbackPair::drain, this));
+    }
+
+    ~LoopbackPair()
+    {
+        boost::system::error_code ignored;
+        writer_.shutdown(tcp::socket::shutdown_send, ignored);
+        readerThread_.join();
+    }
+
+    tcp::socket& writer()
+    {
+        return writer_;
+    }
+};
+
+static const char responseHeader[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+
+void response_concat_write_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 200000;
+    LoopbackPair pair;
+    boost::shared_ptr<const std::string> daytime(new std::string("Thu Oct 17 12:00:00 2024\n"));
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        std::string response = responseHeader;
+        response += *daytime;
+        response += "request ";
+        response += std::to_string(i);
+        response += "\n";
+        boost::asio::write(pair.writer(), boost::asio::buffer(response));
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+GatherResponse make_gather_response(const boost::shared_ptr<const std::string>& daytime, uint64_t i)
+{
+    std::string fragment = "request " + std::to_string(i) + "\n";
+
+    GatherResponse response;
+    response.add_static(responseHeader)
+            .add_shared(daytime)
+            .add_fragment(fragment);
+    return response;
+}
+
+void response_gather_write_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 200000;
+    LoopbackPair pair;
+    boost::shared_ptr<const std::string> daytime(new std::string("Thu Oct 17 12:00:00 2024\n"));
+    std::vector<boost::asio::const_buffer> buffers;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        GatherResponse response = make_gather_response(daytime, i);
+        buffers.clear();
+        response.append_buffers(buffers);
+        boost::asio::write(pair.writer(), GatherBuffers(buffers));
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+void response_coalesced_write_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 200000;
+    const uint64_t responsesPerWrite = 16;
+    LoopbackPair pair;
+    boost::shared_ptr<const std::string> daytime(new std::string("Thu Oct 17 12:00:00 2024\n"));
+    CoalescingWriteQueue queue;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        queue.push(make_gather_response(daytime, i));
+
+        // what a connection does when responses arrive while a write is in flight
+        if (queue.pending() == responsesPerWrite || i + 1 == iterations) {
+            do {
+                boost::asio::write(pair.writer(), queue.next_write());
+            } while (queue.write_completed());
+        }
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+
+
+
+// logging: cost of one LOG_DEBUG call for the thread that makes it, asynchronous vs synchronous,
+// into a stream that discards its input; the asynchronous rings are flushed between batches
+// (outside the measurement) so no record is dropped
+
+void run_log_benchmark(BenchmarkResult& result, bool synchronous)
+{
+    const uint64_t batches = 1000;
+    const uint64_t batchSize = 512;
+
+    DiscardStreamBuf discardBuf;
+    std::ostream discard(&discardBuf);
+    AsyncLogger& logger = AsyncLogger::instance();
+    logger.set_sink(discard);
+    logger.set_synchronous(synchronous);
+
+    for (uint64_t batch = 0; batch < batches; ++batch) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < batchSize; ++i) {
+            LOG_DEBUG("[TcpServer] DEBUG: TcpServer constructor called, open acceptor_ on port ", i, "\n");
+        }
+        result.seconds += seconds_since(start);
+        result.iterations += batchSize;
+        logger.flush();
+    }
+
+    logger.set_synchronous(false);
+    logger.set_sink(std::cout);
+}
+
+void log_async_benchmark(BenchmarkResult& result)
+{
+    run_log_benchmark(result, false);
+}
+
+void log_sync_benchmark(BenchmarkResult& result)
+{
+    run_log_benchmark(result, true);
+}
+
+
+
+
+// daytime string: what make_daytime_string() did before (std::time() + ctime_r() + std::string) against
+// TimeFormatter on the precise and on the coarse clock, and the other wire formats; one call per operation,
+// the way a server formats one response after the other, so most calls hit the formatter's cached second
+
+static volatile size_t formattedBytes = 0;
+
+void daytime_ctime_benchmark(BenchmarkResult& result)
+{
+    const uint64_t iterations = 1000000;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        std::time_t now = std::time(0);
+        char str[26];
+#if defined(_MSC_VER)
+        ctime_s(str, sizeof str, &now);
+#else
+        ctime_r(&now, str);
+#endif
+        std::string daytime = str;
+        formattedBytes = formattedBytes + daytime.size();
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+void run_time_format_benchmark(BenchmarkResult& result, TimeFormat format, TimeZone zone, TimeSource source)
+{
+    const uint64_t iterations = 1000000;
+    TimeFormatter& formatter = TimeFormatter::this_thread();
+    char buffer[TimeFormatter::max_length];
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        formattedBytes = formattedBytes + formatter.format_now(format, zone, source, buffer);
+    }
+    result.seconds = seconds_since(start);
+    result.iterations = iterations;
+}
+
+void time_format_ctime_benchmark(BenchmarkResult& result)
+{
+    run_time_format_benchmark(result, time_format_ctime, time_zone_local, time_source_precise);
+}
+
+void time_format_ctime_coarse_benchmark(BenchmarkResult& result)
+{
+    run_time_format_benchmark(result, time_format_ctime, time_zone_local, time_source_coarse);
+}
+
+void time_format_rfc3339_nano_benchmark(BenchmarkResult& result)
+{
+    run_time_format_benchmark(result, time_format_rfc3339_nano, time_zone_utc, time_source_precise);
+}
+
+void time_format_rfc868_benchmark(BenchmarkResult& result)
+{
+    run_time_format_benchmark(result, time_format_rfc868, time_zone_utc, time_source_coarse);
+}
+
+
+
+
+struct Benchmark {
+    const char*          name;
+    BenchmarkFunction    run;
+};
+
+static const Benchmark benchmarks[] = {
+    { "direct_call",                    &direct_call_benchmark },
+    { "post_bind",                      &post_bind_benchmark },
+    { "post_lambda",                    &post_lambda_benchmark },
+    { "post_chain",                     &post_chain_benchmark },
+    { "dispatch_in_handler",            &dispatch_in_handler_benchmark },
+    { "post_bind_executor_strand",      &post_bind_executor_strand_benchmark },
+    { "steady_timer_arm",               &steady_timer_arm_benchmark },
+    { "steady_timer_fire_latency",      &steady_timer_fire_latency_benchmark },
+    { "loopback_accept_write",          &loopback_accept_write_benchmark },
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+    { "loopback_accept_write_coroutine", &loopback_accept_write_coroutine_benchmark },
+#endif
+    { "response_concat_write",          &response_concat_write_benchmark },
+    { "response_gather_write",          &response_gather_write_benchmark },
+    { "response_coalesced_write",       &response_coalesced_write_benchmark },
+    { "log_async",                      &log_async_benchmark },
+    { "log_sync",                       &log_sync_benchmark },
+    { "daytime_ctime",                  &daytime_ctime_benchmark },
+    { "time_format_ctime",              &time_format_ctime_benchmark },
+    { "time_format_ctime_coarse",       &time_format_ctime_coarse_benchmark },
+    { "time_format_rfc3339_nano",       &time_format_rfc3339_nano_benchmark },
+    { "time_format_rfc868",             &time_format_rfc868_benchmark }
+};
+
+static bool selected(const char* name, int argc, char* argv[])
+{
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(name, argv[i], std::strlen(argv[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    // the io_uring build runs the epoll build instead when the kernel has no io_uring
+    ensure_supported_asio_backend(argc, argv);
+
+    std::cout << "benchmark,iterations,ns_per_op,p50_ns,p99_ns,max_ns,cpu_ns_per_op,allocs_per_op" << std::endl;
+
+    for (size_t i = 0; i < sizeof benchmarks / sizeof benchmarks[0]; ++i) {
+        if (!selected(benchmarks[i].name, argc, argv)) {
+            continue;
+        }
+
+        BenchmarkResult result;
+        uint64_t allocationsBefore = heap_allocations();
+        benchmarks[i].run(result);
+        uint64_t allocations = heap_allocations() - allocationsBefore;
+
+        double nsPerOp = result.iterations ? result.seconds * 1e9 / double(result.iterations) : 0;
+        double cpuNsPerOp = result.iterations ? result.cpuSeconds * 1e9 / double(result.iterations) : 0;
+        double allocsPerOp = result.iterations ? double(allocations) / double(result.iterations) : 0;
+        std::cout << benchmarks[i].name << ","
+                  << result.iterations << ","
+                  << nsPerOp << ","
+                  << result.latency.percentile(0.50) << ","
+                  << result.latency.percentile(0.99) << ","
+                  << result.latency.max() << ","
+                  << cpuNsPerOp << ","
+                  << allocsPerOp << std::endl;
+    }
+
+    return 0;
+}
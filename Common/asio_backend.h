@@ -0,0 +1,170 @@
+#pragma once
+
+// which event backend Boost.Asio was compiled with, a run-time io_uring probe, and a system call counter
+
+// Asio picks its backend at compile time: epoll on Linux, kqueue on BSD/macOS, IOCP on Windows; with
+// BOOST_ASIO_HAS_IO_URING and BOOST_ASIO_DISABLE_EPOLL (Boost >= 1.78, the ASIO_IO_URING CMake option)
+// every socket and timer operation goes through io_uring instead, so there is no way to switch inside
+// one program: the io_uring build of a program falls back by running its epoll build instead
+// (ensure_supported_asio_backend()) when the kernel has no io_uring (before 5.1) or forbids it (seccomp,
+// kernel.io_uring_disabled)
+//
+// SyscallCounter counts the system calls of the constructing thread and of the threads it starts afterwards
+// (those are added when they exit, so join them before reading) through the raw_syscalls:sys_enter
+// tracepoint and perf_event_open(); that needs tracefs and kernel.perf_event_paranoid <= 1 (or CAP_PERFMON),
+// available() says whether it works here
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+inline const char* asio_backend_name()
+{
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#elif defined(BOOST_ASIO_HAS_IOCP)
+    return "iocp";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+    return "kqueue";
+#elif defined(BOOST_ASIO_HAS_DEV_POLL)
+    return "/dev/poll";
+#else
+    return "select";
+#endif
+}
+
+// can this process set up an io_uring at all
+inline bool io_uring_supported()
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    // struct io_uring_params is 120 bytes; all zero asks for the defaults
+    uint64_t params[16];
+    std::memset(params, 0, sizeof params);
+    long fd = ::syscall(__NR_io_uring_setup, 4, params);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(static_cast<int>(fd));
+    return true;
+#else
+    return false;
+#endif
+}
+
+// in an io_uring build, on a kernel without io_uring: replace this process with the epoll build next to it
+// (the same path without the "_io_uring" suffix); returns only if nothing had to be done or exec failed
+inline void ensure_supported_asio_backend(int argc, char* argv[])
+{
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    if (io_uring_supported() || argc < 1) {
+        return;
+    }
+
+    std::string path = argv[0];
+    const std::string suffix = "_io_uring";
+    if (path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        path.erase(path.size() - suffix.size());
+        std::fprintf(stderr, "io_uring is not available on this kernel, running %s (epoll) instead\n", path.c_str());
+        argv[0] = &path[0];
+        ::execv(path.c_str(), argv);
+    }
+    std::fprintf(stderr, "io_uring is not available on this kernel, and there is no epoll build to fall back to\n");
+#else
+    (void)argc;
+    (void)argv;
+#endif
+}
+
+
+class SyscallCounter : private boost::noncopyable {
+private:
+    int    fd_;
+
+#if defined(__linux__)
+    static long tracepoint_id()
+    {
+        const char* paths[] = {
+            "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+            "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"
+        };
+        for (size_t i = 0; i < sizeof paths / sizeof paths[0]; ++i) {
+            if (std::FILE* file = std::fopen(paths[i], "r")) {
+                long id = -1;
+                if (std::fscanf(file, "%ld", &id) != 1) {
+                    id = -1;
+                }
+                std::fclose(file);
+                if (id >= 0) {
+                    return id;
+                }
+            }
+        }
+        return -1;
+    }
+#endif
+
+public:
+    SyscallCounter() :
+        fd_(-1)
+    {
+#if defined(__linux__)
+        long id = tracepoint_id();
+        if (id < 0) {
+            return;
+        }
+
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof attr;
+        attr.config = static_cast<uint64_t>(id);
+        attr.inherit = 1;           // threads started from now on count too
+        attr.disabled = 1;
+
+        fd_ = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd_ >= 0) {
+            ::ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    ~SyscallCounter()
+    {
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    bool available() const
+    {
+        return fd_ >= 0;
+    }
+
+    // system calls since construction, 0 if not available()
+    uint64_t count() const
+    {
+        uint64_t value = 0;
+#if defined(__linux__)
+        if (fd_ < 0 || ::read(fd_, &value, sizeof value) != static_cast<ssize_t>(sizeof value)) {
+            return 0;
+        }
+#endif
+        return value;
+    }
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+// asynchronous low-overhead logger
+
+// LOG_DEBUG("[TcpServer] DEBUG: open acceptor_ on port ", port, "\n") does not format anything:
+// the arguments are copied into a fixed-size record in a per-thread single-producer / single-consumer
+// ring (no lock, no allocation), and a background drain thread formats them with operator<< and writes
+// them to the sink (std::cout by default) exactly as given, so messages carry their own '\n'
+//   - levels below ASYNC_LOG_MIN_LEVEL are compiled out: the macro expands to nothing, arguments are not evaluated
+//   - AsyncLogger::instance().set_level(...) filters the remaining levels at run time (one relaxed load)
+//   - set_synchronous(true) formats and writes at the call site under a mutex instead, like std::cout does
+//   - lines of one thread stay in order; lines of different threads may be interleaved differently than they were logged
+//   - when a ring is full the record is dropped and counted, a logging thread never waits for the sink
+// const char* arguments are stored as pointers, so they must be string literals; pass std::string for anything else
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+enum LogLevel {
+    log_debug   = 0,
+    log_info    = 1,
+    log_warning = 2,
+    log_error   = 3,
+    log_off     = 4
+};
+
+// e.g. -DASYNC_LOG_MIN_LEVEL=2 removes every LOG_DEBUG and LOG_INFO from the program
+#ifndef ASYNC_LOG_MIN_LEVEL
+#define ASYNC_LOG_MIN_LEVEL 0
+#endif
+
+
+namespace async_log_detail {
+
+enum {
+    record_size = 128,
+    args_size   = record_size - 16,
+    ring_size   = 1024      // records per thread, a power of two
+};
+
+typedef void (*FormatFunction)(std::ostream& os, void* args);
+
+// one log statement: its arguments, and the function that knows how to format (and destroy) them
+struct LogRecord {
+    FormatFunction                          format;
+    alignas(16) unsigned char               args[args_size];
+};
+
+template <typename Tuple, size_t... I>
+void write_tuple(std::ostream& os, const Tuple& args, std::index_sequence<I...>)
+{
+    int expand[] = { 0, ((void)(os << std::get<I>(args)), 0)... };
+    (void)expand;
+}
+
+template <typename Tuple>
+void format_and_destroy(std::ostream& os, void* storage)
+{
+    Tuple* args = static_cast<Tuple*>(storage);
+    write_tuple(os, *args, std::make_index_sequence<std::tuple_size<Tuple>::value>());
+    args->~Tuple();
+}
+
+// filled by exactly one logging thread, emptied by the drain thread
+class LogRing {
+private:
+    LogRecord                               records_[ring_size];
+    alignas(64) std::atomic<size_t>         head_;          // next record to fill, written by the producer
+    alignas(64) std::atomic<size_t>         tail_;          // next record to drain, written by the consumer
+    std::atomic<uint64_t>                   dropped_;
+    std::atomic<bool>                       abandoned_;     // the producer thread has exited
+
+public:
+    LogRing() :
+        head_(0),
+        tail_(0),
+        dropped_(0),
+        abandoned_(false)
+    {
+    }
+
+    // producer side: a free record, or 0 if the ring is full
+    LogRecord* try_reserve()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == size_t(ring_size)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        return &records_[head & (ring_size - 1)];
+    }
+
+    void commit()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer side: the oldest record, or 0 if the ring is empty
+    LogRecord* front()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return 0;
+        }
+        return &records_[tail & (ring_size - 1)];
+    }
+
+    void pop()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    uint64_t take_dropped()
+    {
+        return dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+    void abandon()
+    {
+        abandoned_.store(true, std::memory_order_release);
+    }
+
+    bool abandoned() const
+    {
+        return abandoned_.load(std::memory_order_acquire);
+    }
+};
+
+} // namespace async_log_detail
+
+
+class AsyncLogger {
+private:
+    typedef std::shared_ptr<async_log_detail::LogRing> LogRingPtr;
+
+    // registers the ring of a thread on its first log statement, and abandons it when the thread exits
+    struct ThreadRing {
+        LogRingPtr    ring;
+
+        ~ThreadRing()
+        {
+            if (ring) {
+                ring->abandon();
+            }
+        }
+    };
+
+    std::atomic<int>                        level_;
+    std::atomic<bool>                       synchronous_;
+    std::ostream*                           sink_;
+    std::mutex                              mutex_;         // guards rings_ and sink_
+    std::vector<LogRingPtr>                 rings_;
+    std::condition_variable                 wakeUp_;
+    bool                                    running_;
+    std::thread                             drainThread_;
+
+    AsyncLogger() :
+        level_(log_debug),
+        synchronous_(false),
+        sink_(&std::cout),
+        running_(true)
+    {
+        drainThread_ = std::thread(&AsyncLogger::drain_loop, this);
+    }
+
+    ~AsyncLogger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        wakeUp_.notify_one();
+        drainThread_.join();
+    }
+
+    async_log_detail::LogRing& this_thread_ring()
+    {
+        static thread_local ThreadRing threadRing;
+        if (!threadRing.ring) {
+            threadRing.ring = std::make_shared<async_log_detail::LogRing>();
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings_.push_back(threadRing.ring);
+        }
+        return *threadRing.ring;
+    }
+
+    // writes everything that is in the rings now; called with mutex_ held
+    size_t drain_once()
+    {
+        size_t drained = 0;
+        for (size_t i = 0; i < rings_.size(); ) {
+            async_log_detail::LogRing& ring = *rings_[i];
+
+            // the abandoned flag is read before draining: a ring found empty afterwards stays empty
+            bool abandoned = ring.abandoned();
+            while (async_log_detail::LogRecord* record = ring.front()) {
+                record->format(*sink_, record->args);
+                ring.pop();
+                ++drained;
+            }
+
+            uint64_t dropped = ring.take_dropped();
+            if (dropped) {
+                *sink_ << "[AsyncLogger] " << dropped << " log records dropped, the ring of a thread was full\n";
+            }
+
+            if (abandoned) {
+                rings_.erase(rings_.begin() + i);
+            }
+            else {
+                ++i;
+            }
+        }
+        return drained;
+    }
+
+    void drain_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_) {
+            if (drain_once() == 0) {
+                // producers never signal (that would cost them a system call), so poll every millisecond
+                sink_->flush();
+                wakeUp_.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+        drain_once();
+        sink_->flush();
+    }
+
+    template <typename Tuple>
+    void push(async_log_detail::LogRing& ring, Tuple&& args)
+    {
+        typedef typename std::decay<Tuple>::type Stored;
+        async_log_detail::LogRecord* record = ring.try_reserve();
+        if (!record) {
+            return;
+        }
+        new (record->args) Stored(std::forward<Tuple>(args));
+        record->format = &async_log_detail::format_and_destroy<Stored>;
+        ring.commit();
+    }
+
+public:
+    static AsyncLogger& instance()
+    {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    bool enabled(LogLevel level) const
+    {
+        return int(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    LogLevel level() const
+    {
+        return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+    }
+
+    void set_level(LogLevel level)
+    {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    bool synchronous() const
+    {
+        return synchronous_.load(std::memory_order_relaxed);
+    }
+
+    void set_synchronous(bool synchronous)
+    {
+        flush();
+        synchronous_.store(synchronous, std::memory_order_relaxed);
+    }
+
+    // records still in the rings are written to the old sink first
+    void set_sink(std::ostream& sink)
+    {
+        flush();
+        std::lock_guard<std::mutex> lock(mutex_);
+        sink_ = &sink;
+    }
+
+    // returns once everything logged before the call has been written to the sink
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drain_once();
+        sink_->flush();
+    }
+
+    template <typename... Args>
+    void log(Args&&... args)
+    {
+        typedef std::tuple<typename std::decay<Args>::type...> Stored;
+
+        if (synchronous()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            async_log_detail::write_tuple(*sink_, std::forward_as_tuple(args...), std::index_sequence_for<Args...>());
+            return;
+        }
+
+        async_log_detail::LogRing& ring = this_thread_ring();
+        if (sizeof(Stored) <= sizeof(async_log_detail::LogRecord::args) && alignof(Stored) <= 16) {
+            push(ring, Stored(std::forward<Args>(args)...));
+        }
+        else {
+            // too big for a record: format now, and ship the finished line instead
+            std::ostringstream line;
+            async_log_detail::write_tuple(line, std::forward_as_tuple(args...), std::index_sequence_for<Args...>());
+            push(ring, std::tuple<std::string>(line.str()));
+        }
+    }
+};
+
+
+#define ASYNC_LOG(level, ...)                                       \
+    do {                                                            \
+        if (AsyncLogger::instance().enabled(level)) {               \
+            AsyncLogger::instance().log(__VA_ARGS__);               \
+        }                                                           \
+    } while (0)
+
+#if ASYNC_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(...) ASYNC_LOG(log_debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if ASYNC_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(...) ASYNC_LOG(log_info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if ASYNC_LOG_MIN_LEVEL <= 2
+#define LOG_WARNING(...) ASYNC_LOG(log_warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) do {} while (0)
+#endif
+
+#if ASYNC_LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(...) ASYNC_LOG(log_error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
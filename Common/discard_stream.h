@@ -0,0 +1,22 @@
+#pragma once
+
+// a stream buffer that accepts and discards everything written to it
+
+// a sink for the logging benchmarks: formatting and the logger's own work are measured, not a terminal
+// or a file; std::ostream discard(&discardBuf) gives a stream for AsyncLogger::set_sink()
+
+#include <streambuf>
+
+
+class DiscardStreamBuf : public std::streambuf {
+protected:
+    int overflow(int c) override
+    {
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* /*s*/, std::streamsize n) override
+    {
+        return n;
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+// counts every heap allocation of the process, by replacing the global operator new / delete
+
+// every form is replaced (single and array, nothrow, sized and aligned deletes), so each new is paired with
+// the delete it expects;
+// the count covers all threads and every library that allocates through operator new (the standard
+// containers, Boost, Asio's operation objects when no handler allocator is associated)
+// replacement functions may be defined only once per program: include this header from exactly one
+// translation unit (the one with main())
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+
+// GCC inlines a replacement operator delete into its callers when it sees the definition, and then warns
+// that free() gets a pointer from operator new (-Wmismatched-new-delete); kept out of line, every call
+// site pairs operator new with operator delete, as it should
+#if defined(__GNUC__)
+#define HEAP_ALLOCATION_REPLACEMENT __attribute__((noinline))
+#else
+#define HEAP_ALLOCATION_REPLACEMENT
+#endif
+
+
+namespace heap_allocation_detail {
+
+// constant-initialized, so it counts allocations made before main() as well
+static std::atomic<uint64_t> allocations(0);
+
+inline void* allocate(std::size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+#if defined(__cpp_aligned_new)
+inline void* allocate_aligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+#if defined(_WIN32)
+    return ::_aligned_malloc(size ? size : 1, align);
+#else
+    void* p = 0;
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    return ::posix_memalign(&p, align, size ? size : 1) == 0 ? p : 0;
+#endif
+}
+
+inline void release_aligned(void* p) noexcept
+{
+#if defined(_WIN32)
+    ::_aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+#endif
+
+} // namespace heap_allocation_detail
+
+
+// number of operator new calls so far, all threads
+inline uint64_t heap_allocations()
+{
+    return heap_allocation_detail::allocations.load(std::memory_order_relaxed);
+}
+
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new(std::size_t size)
+{
+    if (void* p = heap_allocation_detail::allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new[](std::size_t size)
+{
+    if (void* p = heap_allocation_detail::allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return heap_allocation_detail::allocate(size);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return heap_allocation_detail::allocate(size);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+
+// over-aligned types (alignas larger than the default new alignment, e.g. ThreadMetrics)
+
+#if defined(__cpp_aligned_new)
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = heap_allocation_detail::allocate_aligned(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = heap_allocation_detail::allocate_aligned(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return heap_allocation_detail::allocate_aligned(size, alignment);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return heap_allocation_detail::allocate_aligned(size, alignment);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p, std::align_val_t /*alignment*/) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p, std::align_val_t /*alignment*/) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p, std::size_t /*size*/, std::align_val_t /*alignment*/) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete(void* p, std::align_val_t /*alignment*/, const std::nothrow_t&) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+
+HEAP_ALLOCATION_REPLACEMENT void operator delete[](void* p, std::align_val_t /*alignment*/, const std::nothrow_t&) noexcept
+{
+    heap_allocation_detail::release_aligned(p);
+}
+#endif
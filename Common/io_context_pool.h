@@ -0,0 +1,185 @@
+#pragma once
+
+// a pool of named, CPU-pinned threads running one io_context, blocking or spinning
+
+// a thread blocked in io_context::run() sleeps in epoll_wait() (or GetQueuedCompletionStatus()) whenever
+// there is nothing to do, so every timer expiry and every arriving packet first has to wake it up: a few
+// microseconds of scheduler latency on an idle core, much more when the core went into a deep C-state or
+// the thread was migrated; IoContextPool trades CPU for that latency:
+//   io_run_blocking:         every thread calls io_context::run(), nothing is spent while idle
+//   io_run_spin_then_block:  every thread calls io_context::poll() in a loop for up to spinBudget after the
+//                            last handler it ran, then falls back to a blocking run_one() until the next one;
+//                            a spinBudget of spin_forever never blocks (one busy core per thread)
+// thread i is named "<name>-<i>" and pinned to cpus[i % cpus.size()] (not pinned if cpus is empty)
+// the pool holds work on the io_context from construction on, so its threads keep running while idle:
+//   join():  let the threads finish the work still queued (including timers not yet due), then wait for them
+//   stop():  stop the io_context right away, dropping what is queued, then wait for the threads
+// the io_context is left stopped; call restart() on it before running it again
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "thread_affinity.h"
+
+
+enum IoRunMode {
+    io_run_blocking,
+    io_run_spin_then_block
+};
+
+
+struct IoContextPoolOptions {
+    typedef std::chrono::steady_clock::duration duration;
+
+    static duration spin_forever()
+    {
+        return duration::max();
+    }
+
+    unsigned int                 threads;
+    std::vector<unsigned int>    cpus;
+    IoRunMode                    mode;
+    duration                     spinBudget;     // io_run_spin_then_block only
+    std::string                  name;
+
+    IoContextPoolOptions() :
+        threads(1),
+        mode(io_run_blocking),
+        spinBudget(std::chrono::microseconds(50)),
+        name("io")
+    {
+    }
+
+    // one thread per logical CPU, thread i on cpu i
+    static IoContextPoolOptions one_per_cpu(IoRunMode mode = io_run_blocking)
+    {
+        IoContextPoolOptions options;
+        options.threads = logical_cpu_count();
+        for (unsigned int cpu = 0; cpu < options.threads; ++cpu) {
+            options.cpus.push_back(cpu);
+        }
+        options.mode = mode;
+        return options;
+    }
+};
+
+
+class IoContextPool : private boost::noncopyable {
+private:
+    typedef boost::asio::executor_work_guard<boost::asio::io_context::executor_type> WorkGuard;
+
+    boost::asio::io_context&     io_context_;
+    IoContextPoolOptions         options_;
+    boost::optional<WorkGuard>   work_;
+    boost::thread_group          threads_;
+    std::atomic<unsigned int>    unpinned_;     // threads the platform refused to pin
+    bool                         started_;
+
+    void run_thread(unsigned int index)
+    {
+        set_current_thread_name(options_.name + "-" + std::to_string(index));
+
+        if (!options_.cpus.empty() && !pin_current_thread_to_cpu(options_.cpus[index % options_.cpus.size()])) {
+            ++unpinned_;
+        }
+
+        if (options_.mode == io_run_blocking) {
+            io_context_.run();
+        }
+        else {
+            spin_then_block();
+        }
+    }
+
+    void spin_then_block()
+    {
+        typedef std::chrono::steady_clock Clock;
+        const bool forever = (options_.spinBudget == IoContextPoolOptions::spin_forever());
+
+        // poll() stops the io_context by itself once it is out of work, like run() returns
+        while (!io_context_.stopped()) {
+            Clock::time_point lastHandler = Clock::now();
+            for (;;) {
+                if (io_context_.poll() > 0) {
+                    lastHandler = Clock::now();
+                }
+                else if (io_context_.stopped() || (!forever && Clock::now() - lastHandler >= options_.spinBudget)) {
+                    break;
+                }
+            }
+
+            // nothing for a whole spin budget: sleep until the next handler is ready
+            io_context_.run_one();
+        }
+    }
+
+public:
+    IoContextPool(boost::asio::io_context& io_context, const IoContextPoolOptions& options = IoContextPoolOptions()) :
+        io_context_(io_context),
+        options_(options),
+        work_(boost::asio::make_work_guard(io_context)),
+        unpinned_(0),
+        started_(false)
+    {
+        if (options_.threads == 0) {
+            options_.threads = 1;
+        }
+    }
+
+    ~IoContextPool()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        for (unsigned int i = 0; i < options_.threads; ++i) {
+            threads_.create_thread(boost::bind(&IoContextPool::run_thread, this, i));
+        }
+    }
+
+    // graceful: returns once every queued handler and pending operation has completed
+    void join()
+    {
+        work_ = boost::none;
+        threads_.join_all();
+    }
+
+    // abrupt: handlers not yet started are not run
+    void stop()
+    {
+        work_ = boost::none;
+        if (started_) {
+            io_context_.stop();
+        }
+        threads_.join_all();
+    }
+
+    unsigned int thread_count() const
+    {
+        return options_.threads;
+    }
+
+    // threads that could not be pinned to their cpu; read it after join() or stop()
+    unsigned int unpinned_threads() const
+    {
+        return unpinned_;
+    }
+
+    boost::asio::io_context& get_io_context()
+    {
+        return io_context_;
+    }
+};
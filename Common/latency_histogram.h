@@ -0,0 +1,156 @@
+#pragma once
+
+// HDR-style latency histogram (log-linear buckets), shared by the benchmarks of both projects
+
+// values are recorded in nanoseconds; every power-of-two range [2^k, 2^(k+1)) is split into
+// sub_buckets linear buckets, so any recorded value is reported with a relative error below 1/sub_buckets
+// (about 3%) from 1 ns up to about 18 minutes, in a fixed-size array and without allocating
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+
+
+class LatencyHistogram {
+public:
+    enum {
+        sub_bucket_bits = 5,
+        sub_buckets     = 1 << sub_bucket_bits,     // 32 linear buckets per power of two
+        magnitudes      = 40 - sub_bucket_bits + 1, // up to 2^40 ns
+        bucket_count    = sub_buckets * (magnitudes + 1)
+    };
+
+private:
+    uint64_t    counts_[bucket_count];
+    uint64_t    total_;
+    uint64_t    min_;
+    uint64_t    max_;
+    double      sum_;
+
+public:
+    // the bucket layout is public so that other recorders (e.g. the per-thread histograms of
+    // runtime_metrics.h) can keep counts in the same buckets and add them here
+
+    static int bucket_index(uint64_t value)
+    {
+        if (value < uint64_t(sub_buckets)) {
+            return static_cast<int>(value);
+        }
+
+        int magnitude = 0;
+        while ((value >> magnitude) >= uint64_t(2 * sub_buckets)) {
+            ++magnitude;
+        }
+        // value >> magnitude is in [sub_buckets, 2 * sub_buckets)
+        int index = (magnitude + 1) * sub_buckets + static_cast<int>((value >> magnitude) - sub_buckets);
+        return std::min(index, int(bucket_count) - 1);
+    }
+
+    // highest value that lands in the bucket, so percentiles never under-report
+    static uint64_t bucket_upper_bound(int index)
+    {
+        if (index < sub_buckets) {
+            return uint64_t(index);
+        }
+        int magnitude = index / sub_buckets - 1;
+        uint64_t subBucket = uint64_t(index % sub_buckets) + sub_buckets;
+        return ((subBucket + 1) << magnitude) - 1;
+    }
+
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(counts_, counts_ + bucket_count, uint64_t(0));
+        total_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+        sum_ = 0;
+    }
+
+    void record(uint64_t nanoseconds)
+    {
+        ++counts_[bucket_index(nanoseconds)];
+        ++total_;
+        min_ = std::min(min_, nanoseconds);
+        max_ = std::max(max_, nanoseconds);
+        sum_ += double(nanoseconds);
+    }
+
+    // count values of nanoseconds each
+    void record(uint64_t nanoseconds, uint64_t count)
+    {
+        if (count == 0) {
+            return;
+        }
+        counts_[bucket_index(nanoseconds)] += count;
+        total_ += count;
+        min_ = std::min(min_, nanoseconds);
+        max_ = std::max(max_, nanoseconds);
+        sum_ += double(nanoseconds) * double(count);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (int i = 0; i < bucket_count; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        sum_ += other.sum_;
+    }
+
+    uint64_t count() const
+    {
+        return total_;
+    }
+
+    uint64_t min() const
+    {
+        return total_ ? min_ : 0;
+    }
+
+    uint64_t max() const
+    {
+        return max_;
+    }
+
+    double mean() const
+    {
+        return total_ ? sum_ / double(total_) : 0;
+    }
+
+    // value at or below which the given fraction (0.5 = median, 0.999 = p99.9) of all recorded values lie
+    uint64_t percentile(double fraction) const
+    {
+        if (total_ == 0) {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(fraction * double(total_) + 0.5);
+        rank = std::max<uint64_t>(1, std::min(rank, total_));
+
+        uint64_t seen = 0;
+        for (int i = 0; i < bucket_count; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(bucket_upper_bound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    // one line: count, then p50 / p99 / p99.9 / max in microseconds
+    void print_summary(std::ostream& os) const
+    {
+        os << "count=" << count()
+           << " p50=" << percentile(0.50) / 1000.0 << "us"
+           << " p99=" << percentile(0.99) / 1000.0 << "us"
+           << " p99.9=" << percentile(0.999) / 1000.0 << "us"
+           << " max=" << max() / 1000.0 << "us";
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+// drift-free periodic task on top of steady_timer, with catch-up policies and a lateness histogram
+
+// tick n is always due at start + n * period (never "previous expiry + period" measured after a late
+// handler), so lateness does not accumulate; when the io_context thread stalls and several ticks are
+// missed, the policy decides what happens:
+//   catch_up_fire_all:  run the task once for every missed tick, back to back
+//   catch_up_skip:      drop the missed ticks, run once for the most recent one
+//   catch_up_coalesce:  run once, telling the task how many ticks that run stands for
+// every run records how late it started (handler start - due time) in a LatencyHistogram
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "latency_histogram.h"
+
+
+enum CatchUpPolicy {
+    catch_up_fire_all,
+    catch_up_skip,
+    catch_up_coalesce
+};
+
+
+class PeriodicTask : private boost::noncopyable {
+public:
+    typedef std::chrono::steady_clock       clock_type;
+    typedef clock_type::duration            duration;
+    typedef clock_type::time_point          time_point;
+
+    struct Tick {
+        uint64_t        index;          // tick number since start()
+        time_point      due;            // when it should have run (the oldest one for coalesced runs)
+        duration        lateness;       // how late this run started
+        uint64_t        ticks;          // > 1 only for coalesced runs
+    };
+
+    typedef std::function<void(const Tick&)> Task;
+
+private:
+    boost::asio::steady_timer    timer_;
+    duration                     period_;
+    CatchUpPolicy                policy_;
+    Task                         task_;
+    time_point                   origin_;
+    uint64_t                     nextIndex_;
+    bool                         running_;
+    LatencyHistogram             lateness_;
+    uint64_t                     runs_;
+    uint64_t                     skipped_;
+
+    time_point due_time(uint64_t index) const
+    {
+        return origin_ + period_ * static_cast<duration::rep>(index);
+    }
+
+    void arm()
+    {
+        timer_.expires_at(due_time(nextIndex_));
+        timer_.async_wait(boost::bind(&PeriodicTask::handle_timer, this, boost::asio::placeholders::error));
+    }
+
+    void run(uint64_t index, time_point due, uint64_t ticks)
+    {
+        Tick tick;
+        tick.index = index;
+        tick.due = due;
+        tick.lateness = std::max(clock_type::now() - due, duration::zero());
+        tick.ticks = ticks;
+
+        lateness_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tick.lateness).count()));
+        ++runs_;
+        task_(tick);
+    }
+
+    void handle_timer(const boost::system::error_code& errorCode)
+    {
+        if (errorCode || !running_) {
+            return;
+        }
+
+        // every tick from nextIndex_ up to lastDue is due now; normally that is exactly one
+        uint64_t lastDue = static_cast<uint64_t>((clock_type::now() - origin_) / period_);
+        if (lastDue < nextIndex_) {
+            lastDue = nextIndex_;
+        }
+        uint64_t dueTicks = lastDue - nextIndex_ + 1;
+
+        switch (policy_) {
+        case catch_up_fire_all:
+            for (uint64_t index = nextIndex_; index <= lastDue && running_; ++index) {
+                run(index, due_time(index), 1);
+            }
+            break;
+
+        case catch_up_skip:
+            skipped_ += dueTicks - 1;
+            run(lastDue, due_time(lastDue), 1);
+            break;
+
+        case catch_up_coalesce:
+            run(lastDue, due_time(nextIndex_), dueTicks);
+            break;
+        }
+
+        nextIndex_ = lastDue + 1;
+        if (running_) {
+            arm();
+        }
+    }
+
+public:
+    PeriodicTask(boost::asio::io_context& io_context,
+                 duration period,
+                 const Task& task,
+                 CatchUpPolicy policy = catch_up_skip) :
+        timer_(io_context),
+        period_(period),
+        policy_(policy),
+        task_(task),
+        nextIndex_(0),
+        running_(false),
+        runs_(0),
+        skipped_(0)
+    {
+    }
+
+    // the first run is due one period from now
+    void start()
+    {
+        running_ = true;
+        origin_ = clock_type::now();
+        nextIndex_ = 1;
+        arm();
+    }
+
+    // may be called from inside the task
+    void stop()
+    {
+        running_ = false;
+        timer_.cancel();
+    }
+
+    bool running() const
+    {
+        return running_;
+    }
+
+    const LatencyHistogram& lateness() const
+    {
+        return lateness_;
+    }
+
+    uint64_t runs() const
+    {
+        return runs_;
+    }
+
+    // ticks dropped by catch_up_skip
+    uint64_t skipped() const
+    {
+        return skipped_;
+    }
+};
@@ -0,0 +1,529 @@
+#pragma once
+
+// runtime metrics of the io_context threads and the servers running on them, removable at compile time
+
+// every thread that records gets its own ThreadMetrics slot (histograms and counters), written by that thread
+// only, with relaxed loads and stores instead of locked read-modify-writes, so recording costs about what a
+// plain increment costs and never contends; a reader adds all slots up (a consistent-enough snapshot, like
+// ShardedCounter), and reports compare two snapshots, so every rate and percentile is over the interval
+// between them:
+//   handler queueing delay:   how long a ready handler waits before it runs (QueueDelayProbe posts one)
+//   handler execution time:   every handler wrapped with METRICS_HANDLER(...), and how busy each thread is
+//   accepts, TcpConnection objects alive, bytes written, async_write completion latency, timer lateness
+//   receive to reply:         time service requests, from the kernel's receive timestamp to the reply
+// MetricsEndpoint answers every connection to its port with a plain-text report, MetricsDumper logs one
+// periodically (LOG_INFO)
+// -DASIO_METRICS=0 (the ASIO_METRICS CMake option) turns every METRICS_* macro into nothing: the arguments
+// are not evaluated, no clock is read, no handler is wrapped; the report then only says so
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "async_logger.h"
+#include "latency_histogram.h"
+#include "periodic_task.h"
+
+#ifndef ASIO_METRICS
+#define ASIO_METRICS 1
+#endif
+
+
+enum MetricsHistogram {
+    metric_handler_delay,       // posted -> running
+    metric_handler_time,        // handler execution
+    metric_write_latency,       // async_write started -> completion handler running
+    metric_timer_lateness,      // expiry -> handler running
+    metric_receive_to_reply,    // kernel receive timestamp of a time request -> its reply sent (time_service.h)
+    metric_histogram_count
+};
+
+enum MetricsCounter {
+    counter_accepted,           // connections accepted (admitted or not)
+    counter_opened,             // TcpConnection objects constructed
+    counter_closed,             // TcpConnection objects destroyed
+    counter_bytes_written,
+    metric_counter_count
+};
+
+typedef std::chrono::steady_clock MetricsClock;
+
+inline uint64_t metrics_ns_since(MetricsClock::time_point since)
+{
+    MetricsClock::duration elapsed = MetricsClock::now() - since;
+    return elapsed > MetricsClock::duration::zero()
+           ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+           : 0;
+}
+
+
+namespace metrics_detail {
+
+// only the owning thread writes, so a load and a store are enough (and much cheaper than fetch_add)
+inline void single_writer_add(std::atomic<uint64_t>& value, uint64_t n)
+{
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+} // namespace metrics_detail
+
+
+// a LatencyHistogram that one thread writes and any thread may read
+class ThreadHistogram : private boost::noncopyable {
+private:
+    std::atomic<uint64_t>    counts_[LatencyHistogram::bucket_count];
+    std::atomic<uint64_t>    count_;
+    std::atomic<uint64_t>    sum_;
+
+public:
+    ThreadHistogram() :
+        count_(0),
+        sum_(0)
+    {
+        for (int i = 0; i < LatencyHistogram::bucket_count; ++i) {
+            counts_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t nanoseconds)
+    {
+        metrics_detail::single_writer_add(counts_[LatencyHistogram::bucket_index(nanoseconds)], 1);
+        metrics_detail::single_writer_add(count_, 1);
+        metrics_detail::single_writer_add(sum_, nanoseconds);
+    }
+
+    uint64_t count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t sum() const
+    {
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    // adds the bucket counts to buckets (LatencyHistogram::bucket_count entries)
+    void add_to(std::vector<uint64_t>& buckets) const
+    {
+        for (int i = 0; i < LatencyHistogram::bucket_count; ++i) {
+            buckets[i] += counts_[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+
+struct alignas(64) ThreadMetrics : private boost::noncopyable {
+    ThreadHistogram          histograms[metric_histogram_count];
+    std::atomic<uint64_t>    counters[metric_counter_count];
+    bool                     inUse;         // guarded by RuntimeMetrics::mutex_
+
+    ThreadMetrics() :
+        inUse(false)
+    {
+        for (int i = 0; i < metric_counter_count; ++i) {
+            counters[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(MetricsHistogram histogram, uint64_t nanoseconds)
+    {
+        histograms[histogram].record(nanoseconds);
+    }
+
+    void count(MetricsCounter counter, uint64_t n = 1)
+    {
+        metrics_detail::single_writer_add(counters[counter], n);
+    }
+};
+
+
+// everything recorded up to one point in time; histograms as bucket counts, so that two snapshots can be subtracted
+struct MetricsSnapshot {
+    typedef std::pair<uint64_t, uint64_t> ThreadLoad;      // handlers run, nanoseconds spent in them
+
+    MetricsClock::time_point    taken;
+    std::vector<uint64_t>       buckets[metric_histogram_count];
+    uint64_t                    counters[metric_counter_count];
+    std::vector<ThreadLoad>     threads;        // per slot
+
+    explicit MetricsSnapshot(MetricsClock::time_point when = MetricsClock::now()) :
+        taken(when)
+    {
+        for (int i = 0; i < metric_histogram_count; ++i) {
+            buckets[i].assign(LatencyHistogram::bucket_count, 0);
+        }
+        for (int i = 0; i < metric_counter_count; ++i) {
+            counters[i] = 0;
+        }
+    }
+
+    // the values recorded after previous; reported at their bucket's upper bound (at most about 3% high)
+    LatencyHistogram since(const MetricsSnapshot& previous, MetricsHistogram histogram) const
+    {
+        LatencyHistogram interval;
+        for (int i = 0; i < LatencyHistogram::bucket_count; ++i) {
+            interval.record(LatencyHistogram::bucket_upper_bound(i),
+                            buckets[histogram][i] - previous.buckets[histogram][i]);
+        }
+        return interval;
+    }
+
+    uint64_t since(const MetricsSnapshot& previous, MetricsCounter counter) const
+    {
+        return counters[counter] - previous.counters[counter];
+    }
+};
+
+
+class RuntimeMetrics : private boost::noncopyable {
+private:
+    std::mutex                   mutex_;
+    std::deque<ThreadMetrics>    slots_;        // never shrinks, so a slot's address stays valid
+    MetricsClock::time_point     started_;
+
+    // gives the slot back when its thread exits; the next new thread takes it over, counts and all,
+    // so totals never go backwards
+    struct ThreadSlot {
+        ThreadMetrics*    metrics;
+
+        ThreadSlot() :
+            metrics(RuntimeMetrics::instance().acquire())
+        {
+        }
+
+        ~ThreadSlot()
+        {
+            RuntimeMetrics::instance().release(metrics);
+        }
+    };
+
+    RuntimeMetrics() :
+        started_(MetricsClock::now())
+    {
+    }
+
+    ThreadMetrics* acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i].inUse) {
+                slots_[i].inUse = true;
+                return &slots_[i];
+            }
+        }
+        slots_.emplace_back();
+        slots_.back().inUse = true;
+        return &slots_.back();
+    }
+
+    void release(ThreadMetrics* metrics)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics->inUse = false;
+    }
+
+public:
+    static RuntimeMetrics& instance()
+    {
+        static RuntimeMetrics metrics;
+        return metrics;
+    }
+
+    static ThreadMetrics& this_thread()
+    {
+        static thread_local ThreadSlot slot;
+        return *slot.metrics;
+    }
+
+    MetricsClock::time_point started() const
+    {
+        return started_;
+    }
+
+    MetricsSnapshot snapshot()
+    {
+        MetricsSnapshot snapshot;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t s = 0; s < slots_.size(); ++s) {
+            const ThreadMetrics& slot = slots_[s];
+            for (int i = 0; i < metric_histogram_count; ++i) {
+                slot.histograms[i].add_to(snapshot.buckets[i]);
+            }
+            for (int i = 0; i < metric_counter_count; ++i) {
+                snapshot.counters[i] += slot.counters[i].load(std::memory_order_relaxed);
+            }
+            snapshot.threads.push_back(std::make_pair(slot.histograms[metric_handler_time].count(),
+                                                      slot.histograms[metric_handler_time].sum()));
+        }
+        return snapshot;
+    }
+};
+
+
+#if ASIO_METRICS
+#define METRICS(...) __VA_ARGS__
+#define METRICS_RECORD(histogram, nanoseconds) RuntimeMetrics::this_thread().record(histogram, nanoseconds)
+#define METRICS_COUNT(counter, n) RuntimeMetrics::this_thread().count(counter, n)
+#define METRICS_HANDLER(handler) make_measured_handler(handler)
+#else
+#define METRICS(...)
+#define METRICS_RECORD(histogram, nanoseconds) do {} while (0)
+#define METRICS_COUNT(counter, n) do {} while (0)
+#define METRICS_HANDLER(handler) (handler)
+#endif
+
+
+// completion handler wrapper that records how long the handler ran (metric_handler_time);
+// goes inside make_recycling_handler(...), which supplies the allocator
+template <typename Handler>
+class MeasuredHandler {
+private:
+    Handler    handler_;
+
+public:
+    explicit MeasuredHandler(const Handler& handler) :
+        handler_(handler)
+    {
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        MetricsClock::time_point start = MetricsClock::now();
+        handler_(std::forward<Args>(args)...);
+        RuntimeMetrics::this_thread().record(metric_handler_time, metrics_ns_since(start));
+    }
+};
+
+template <typename Handler>
+inline MeasuredHandler<Handler> make_measured_handler(const Handler& handler)
+{
+    return MeasuredHandler<Handler>(handler);
+}
+
+
+// plain-text report of what happened between previous and current
+inline void write_metrics_report(std::ostream& os, const MetricsSnapshot& current, const MetricsSnapshot& previous)
+{
+#if ASIO_METRICS
+    double seconds = std::chrono::duration<double>(current.taken - previous.taken).count();
+    if (seconds <= 0) {
+        seconds = 1e-9;
+    }
+    double uptime = std::chrono::duration<double>(current.taken - RuntimeMetrics::instance().started()).count();
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(2);
+    os << "interval_seconds " << seconds << "\n";
+    os << "uptime_seconds " << uptime << "\n";
+    os << "accepts_total " << current.counters[counter_accepted] << "\n";
+    os << "accepts_per_second " << current.since(previous, counter_accepted) / seconds << "\n";
+    os << "connections_active " << int64_t(current.counters[counter_opened] - current.counters[counter_closed]) << "\n";
+    os << "bytes_written_total " << current.counters[counter_bytes_written] << "\n";
+    os << "bytes_written_per_second " << current.since(previous, counter_bytes_written) / seconds << "\n";
+
+    const char* names[metric_histogram_count] = {
+        "handler_queue_delay", "handler_execution", "async_write_latency", "timer_lateness", "receive_to_reply"
+    };
+    for (int i = 0; i < metric_histogram_count; ++i) {
+        os << names[i] << " ";
+        current.since(previous, MetricsHistogram(i)).print_summary(os);
+        os << "\n";
+    }
+
+    // a thread near 100% busy is the stage that saturates
+    for (size_t t = 0; t < current.threads.size(); ++t) {
+        MetricsSnapshot::ThreadLoad before = t < previous.threads.size() ? previous.threads[t] : MetricsSnapshot::ThreadLoad(0, 0);
+        os << "thread " << t
+           << " handlers_per_second=" << (current.threads[t].first - before.first) / seconds
+           << " busy_percent=" << (current.threads[t].second - before.second) / (seconds * 1e7) << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+#else
+    (void)current;
+    (void)previous;
+    os << "metrics compiled out (ASIO_METRICS=0)\n";
+#endif
+}
+
+
+// measures how long a ready handler waits in the io_context before it runs: every interval a timer posts a
+// time-stamped handler, and the handler records how long ago that was (metric_handler_delay); the timer's
+// own lateness goes into metric_timer_lateness
+// with ASIO_METRICS=0 it never starts
+class QueueDelayProbe : private boost::noncopyable {
+private:
+    boost::asio::io_context&       io_context_;
+    boost::asio::steady_timer      timer_;
+    MetricsClock::duration         interval_;
+    bool                           running_;
+
+    void arm()
+    {
+        timer_.expires_after(interval_);
+        timer_.async_wait(boost::bind(&QueueDelayProbe::handle_timer, this, boost::asio::placeholders::error));
+    }
+
+    void handle_timer(const boost::system::error_code& errorCode)
+    {
+        if (errorCode || !running_) {
+            return;
+        }
+        METRICS_RECORD(metric_timer_lateness, metrics_ns_since(timer_.expiry()));
+        boost::asio::post(io_context_, boost::bind(&QueueDelayProbe::handle_posted, this, MetricsClock::now()));
+    }
+
+    void handle_posted(MetricsClock::time_point posted)
+    {
+        METRICS_RECORD(metric_handler_delay, metrics_ns_since(posted));
+#if !ASIO_METRICS
+        (void)posted;
+#endif
+        if (running_) {
+            arm();
+        }
+    }
+
+public:
+    explicit QueueDelayProbe(boost::asio::io_context& io_context,
+                             MetricsClock::duration interval = std::chrono::milliseconds(10)) :
+        io_context_(io_context),
+        timer_(io_context),
+        interval_(interval),
+        running_(false)
+    {
+#if ASIO_METRICS
+        running_ = true;
+        arm();
+#endif
+    }
+
+    ~QueueDelayProbe()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        running_ = false;
+        timer_.cancel();
+    }
+};
+
+
+// the local stats endpoint: every connection gets the report since the previous connection, then EOF
+//   nc 127.0.0.1 <port>
+class MetricsEndpoint : private boost::noncopyable {
+private:
+    typedef boost::asio::ip::tcp                    tcp;
+    typedef boost::shared_ptr<tcp::socket>          SocketPtr;
+    typedef boost::shared_ptr<const std::string>    TextPtr;
+
+    tcp::acceptor      acceptor_;
+    MetricsSnapshot    previous_;
+
+    void start_accept()
+    {
+        SocketPtr socket(new tcp::socket(acceptor_.get_executor()));
+        acceptor_.async_accept(*socket, boost::bind(&MetricsEndpoint::handle_accept, this, socket,
+                                                    boost::asio::placeholders::error));
+    }
+
+    void handle_accept(const SocketPtr& socket, const boost::system::error_code& errorCode)
+    {
+        if (errorCode == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (!errorCode) {
+            MetricsSnapshot current = RuntimeMetrics::instance().snapshot();
+            std::ostringstream text;
+            write_metrics_report(text, current, previous_);
+            previous_ = current;
+
+            TextPtr report(new std::string(text.str()));
+            boost::asio::async_write(*socket, boost::asio::buffer(*report),
+                                     boost::bind(&MetricsEndpoint::handle_write, socket, report));
+        }
+        start_accept();
+    }
+
+    // report is bound only to keep the text alive until it is written
+    static void handle_write(const SocketPtr& socket, const TextPtr& /*report*/)
+    {
+        boost::system::error_code ignored;
+        socket->shutdown(tcp::socket::shutdown_both, ignored);
+        socket->close(ignored);
+    }
+
+public:
+    // port 0 = let the OS pick one; only reachable from this host
+    MetricsEndpoint(boost::asio::io_context& io_context, unsigned short port) :
+        acceptor_(io_context),
+        previous_(RuntimeMetrics::instance().started())
+    {
+        tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+        start_accept();
+    }
+
+    ~MetricsEndpoint()
+    {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+    }
+
+    unsigned short port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+};
+
+
+// logs the report since the previous one every period
+class MetricsDumper : private boost::noncopyable {
+private:
+    MetricsSnapshot    previous_;
+    PeriodicTask       task_;
+
+    void dump(const PeriodicTask::Tick& /*tick*/)
+    {
+        MetricsSnapshot current = RuntimeMetrics::instance().snapshot();
+        std::ostringstream text;
+        text << "[metrics]\n";
+        write_metrics_report(text, current, previous_);
+        previous_ = current;
+        LOG_INFO(text.str());
+    }
+
+public:
+    MetricsDumper(boost::asio::io_context& io_context, PeriodicTask::duration period) :
+        previous_(RuntimeMetrics::instance().snapshot()),
+        task_(io_context, period, boost::bind(&MetricsDumper::dump, this, _1), catch_up_skip)
+    {
+        task_.start();
+    }
+
+    ~MetricsDumper()
+    {
+        task_.stop();
+    }
+};
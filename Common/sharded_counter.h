@@ -0,0 +1,141 @@
+#pragma once
+
+// lock-free sharded counters and statistics
+
+// instead of one shared counter (which every thread has to lock, or to bounce between caches),
+// every thread updates its own cache-line sized slot with relaxed atomics;
+// readers add all slots up, so writes never contend and reads are a little more expensive;
+// a value read while writers are running is a consistent-enough snapshot, not an exact point in time
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace sharded_detail {
+
+enum {
+    cache_line_size = 64,
+    slot_count      = 64    // threads beyond this share slots (still correct, just contended again)
+};
+
+// every thread gets the next slot index the first time it touches any sharded counter
+inline size_t this_thread_slot()
+{
+    static std::atomic<size_t> nextSlot(0);
+    static thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % slot_count;
+    return slot;
+}
+
+} // namespace sharded_detail
+
+
+class ShardedCounter {
+private:
+    struct alignas(sharded_detail::cache_line_size) Slot {
+        std::atomic<uint64_t>    value;
+    };
+
+    Slot    slots_[sharded_detail::slot_count];
+
+public:
+    ShardedCounter()
+    {
+        reset();
+    }
+
+    void add(uint64_t n = 1)
+    {
+        slots_[sharded_detail::this_thread_slot()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < sharded_detail::slot_count; ++i) {
+            sum += slots_[i].value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < sharded_detail::slot_count; ++i) {
+            slots_[i].value.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+
+// count / sum / min / max of recorded samples, e.g. bytes per write or latencies
+class ShardedStatistics {
+public:
+    struct Snapshot {
+        uint64_t    count;
+        uint64_t    sum;
+        uint64_t    min;
+        uint64_t    max;
+
+        double mean() const
+        {
+            return count ? double(sum) / double(count) : 0;
+        }
+    };
+
+private:
+    struct alignas(sharded_detail::cache_line_size) Slot {
+        std::atomic<uint64_t>    count;
+        std::atomic<uint64_t>    sum;
+        std::atomic<uint64_t>    min;
+        std::atomic<uint64_t>    max;
+    };
+
+    Slot    slots_[sharded_detail::slot_count];
+
+public:
+    ShardedStatistics()
+    {
+        reset();
+    }
+
+    void record(uint64_t sample)
+    {
+        Slot& slot = slots_[sharded_detail::this_thread_slot()];
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+        slot.sum.fetch_add(sample, std::memory_order_relaxed);
+
+        // a slot is normally written by one thread only, so these loops almost never retry
+        uint64_t current = slot.min.load(std::memory_order_relaxed);
+        while (sample < current && !slot.min.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+        }
+        current = slot.max.load(std::memory_order_relaxed);
+        while (sample > current && !slot.max.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+        }
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot total = { 0, 0, UINT64_MAX, 0 };
+        for (size_t i = 0; i < sharded_detail::slot_count; ++i) {
+            total.count += slots_[i].count.load(std::memory_order_relaxed);
+            total.sum += slots_[i].sum.load(std::memory_order_relaxed);
+            total.min = std::min(total.min, slots_[i].min.load(std::memory_order_relaxed));
+            total.max = std::max(total.max, slots_[i].max.load(std::memory_order_relaxed));
+        }
+        if (total.count == 0) {
+            total.min = 0;
+        }
+        return total;
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < sharded_detail::slot_count; ++i) {
+            slots_[i].count.store(0, std::memory_order_relaxed);
+            slots_[i].sum.store(0, std::memory_order_relaxed);
+            slots_[i].min.store(UINT64_MAX, std::memory_order_relaxed);
+            slots_[i].max.store(0, std::memory_order_relaxed);
+        }
+    }
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+// helpers to pin threads to CPUs and to name them, shared by BasicSkills and IntroductionToSockets
+
+#if defined(_WIN32)
+// winsock2.h must come before windows.h, otherwise windows.h drags in the old winsock.h
+// and Boost.Asio refuses to compile
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <string>
+
+#include <boost/thread/thread.hpp>
+
+
+// number of logical CPUs, never 0 (hardware_concurrency() returns 0 when it cannot tell)
+inline unsigned int logical_cpu_count()
+{
+    unsigned int count = boost::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+// pin the calling thread to one logical CPU, so that everything this thread touches
+// (its io_context, its sockets, its connection objects) stays in that core's caches;
+// returns false if the platform refused (cpu out of range, not permitted, not supported)
+inline bool pin_current_thread_to_cpu(unsigned int cpu)
+{
+#if defined(_WIN32)
+    if (cpu >= sizeof(DWORD_PTR) * 8) {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// name the calling thread, as shown by top -H, gdb, perf and the Visual Studio debugger; Linux keeps
+// only the first 15 characters; returns false if the platform refused or has no thread names
+inline bool set_current_thread_name(const std::string& name)
+{
+#if defined(_WIN32)
+    // SetThreadDescription() exists from Windows 10 1607 on, so look it up instead of linking it
+    typedef HRESULT (WINAPI *SetThreadDescriptionFunction)(HANDLE, PCWSTR);
+    HMODULE kernel32 = GetModuleHandleW(L"kernel32.dll");
+    SetThreadDescriptionFunction setThreadDescription = kernel32 == NULL ? NULL :
+        reinterpret_cast<SetThreadDescriptionFunction>(GetProcAddress(kernel32, "SetThreadDescription"));
+    if (setThreadDescription == NULL) {
+        return false;
+    }
+    std::wstring wideName(name.begin(), name.end());
+    return SUCCEEDED(setThreadDescription(GetCurrentThread(), wideName.c_str()));
+#elif defined(__linux__)
+    return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+#elif defined(__APPLE__)
+    return pthread_setname_np(name.c_str()) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+}
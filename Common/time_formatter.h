@@ -0,0 +1,330 @@
+#pragma once
+
+// wall clock reading and allocation-free time formatting: ctime, RFC 3339 (seconds, micro, nano), RFC 868
+
+// std::time() + ctime_r() + std::string costs a time zone lookup (under a lock in most C libraries), a
+// printf-style format and a heap allocation per call, and only knows seconds; TimeFormatter instead
+//   - reads the clock it is asked for: time_source_precise is clock_gettime(CLOCK_REALTIME) (a vDSO call, no
+//     system call), time_source_coarse is CLOCK_REALTIME_COARSE (cheaper still, but only as fresh as the last
+//     timer tick, 1-4 ms; do not use it to tell which second just started)
+//   - formats into the caller's buffer (max_length bytes, no terminating NUL) with a two-digit lookup table
+//   - keeps the last second it rendered, per time zone: the same second again is a memcpy, a new second of
+//     the same day rewrites only hh:mm:ss, only a new day goes through the calendar arithmetic again
+//   - asks the C library for the local UTC offset once per minute, not once per call
+// formats:
+//   time_format_ctime:          "Sat Oct 17 12:34:56 2026\n", exactly what ctime() writes (25 bytes)
+//   time_format_rfc3339:        "2026-10-17T12:34:56Z", or "+02:00" instead of "Z" in local time
+//   time_format_rfc3339_micro:  "2026-10-17T12:34:56.123456Z"
+//   time_format_rfc3339_nano:   "2026-10-17T12:34:56.123456789Z"
+//   time_format_rfc868:         4 bytes, big endian, seconds since 1900-01-01 00:00 UTC (wraps in 2036)
+// years 0 to 9999 only; not thread-safe, use one formatter per thread (this_thread())
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <boost/noncopyable.hpp>
+
+#if defined(_WIN32)
+// winsock2.h must come before windows.h, see thread_affinity.h
+#include <winsock2.h>
+#include <windows.h>
+#endif
+
+#if !defined(__linux__)
+#include <chrono>
+#endif
+
+
+enum TimeSource {
+    time_source_coarse,
+    time_source_precise
+};
+
+enum TimeZone {
+    time_zone_utc,
+    time_zone_local
+};
+
+enum TimeFormat {
+    time_format_ctime,
+    time_format_rfc3339,
+    time_format_rfc3339_micro,
+    time_format_rfc3339_nano,
+    time_format_rfc868
+};
+
+
+struct WallTime {
+    int64_t     seconds;        // since 1970-01-01 00:00 UTC
+    uint32_t    nanoseconds;
+};
+
+inline WallTime read_wall_clock(TimeSource source)
+{
+    WallTime time;
+#if defined(__linux__)
+    timespec now;
+    ::clock_gettime(source == time_source_coarse ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME, &now);
+    time.seconds = static_cast<int64_t>(now.tv_sec);
+    time.nanoseconds = static_cast<uint32_t>(now.tv_nsec);
+#else
+#if defined(_WIN32)
+    if (source == time_source_coarse) {
+        // 100 ns units since 1601-01-01
+        FILETIME fileTime;
+        ::GetSystemTimeAsFileTime(&fileTime);
+        uint64_t ticks = (uint64_t(fileTime.dwHighDateTime) << 32 | fileTime.dwLowDateTime) - 116444736000000000ULL;
+        time.seconds = static_cast<int64_t>(ticks / 10000000);
+        time.nanoseconds = static_cast<uint32_t>(ticks % 10000000) * 100;
+        return time;
+    }
+#endif
+    (void)source;
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    time.seconds = nanoseconds / 1000000000;
+    time.nanoseconds = static_cast<uint32_t>(nanoseconds % 1000000000);
+#endif
+    return time;
+}
+
+
+namespace time_format_detail {
+
+inline const char* two_digits(unsigned int value)
+{
+    static const char table[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    return &table[value * 2];
+}
+
+// count digits of value, zero-padded, written back to front two at a time
+inline void write_digits(char* out, uint32_t value, int count)
+{
+    while (count >= 2) {
+        count -= 2;
+        std::memcpy(out + count, two_digits(value % 100), 2);
+        value /= 100;
+    }
+    if (count == 1) {
+        out[0] = char('0' + value % 10);
+    }
+}
+
+inline int64_t floor_div(int64_t value, int64_t divisor)
+{
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+// days since 1970-01-01 to year / month (1-12) / day (1-31), proleptic Gregorian (H. Hinnant's algorithm)
+inline void civil_from_days(int64_t days, int& year, unsigned int& month, unsigned int& day)
+{
+    days += 719468;
+    int64_t era = floor_div(days, 146097);
+    unsigned int dayOfEra = static_cast<unsigned int>(days - era * 146097);
+    unsigned int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned int monthFromMarch = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    year = static_cast<int>(yearOfEra + era * 400) + (month <= 2 ? 1 : 0);
+}
+
+} // namespace time_format_detail
+
+
+class TimeFormatter : private boost::noncopyable {
+public:
+    enum {
+        max_length          = 40,
+        ctime_length        = 25,
+        rfc3339_length      = 19        // without fraction and zone
+    };
+
+    // RFC 868 counts from 1900-01-01, the Unix epoch is 2208988800 seconds later
+    static const int64_t rfc868_epoch_offset = 2208988800LL;
+
+private:
+    // one rendered second; the time of day sits at offset 11 in both strings
+    struct RenderedSecond {
+        int64_t    second;          // seconds since the epoch in the zone's local time
+        int64_t    day;
+        char       ctime[ctime_length];
+        char       rfc3339[rfc3339_length];
+
+        RenderedSecond() :
+            second(INT64_MIN),
+            day(INT64_MIN)
+        {
+        }
+    };
+
+    RenderedSecond    utc_;
+    RenderedSecond    local_;
+    int64_t           offsetMinute_;    // UTC minute the local offset was looked up for
+    int32_t           offset_;          // seconds east of UTC
+
+    static int32_t lookup_utc_offset(int64_t utcSeconds)
+    {
+        std::time_t t = static_cast<std::time_t>(utcSeconds);
+        std::tm local;
+#if defined(_WIN32)
+        if (localtime_s(&local, &t) != 0) {
+            return 0;
+        }
+        return static_cast<int32_t>(_mkgmtime(&local) - t);
+#else
+        if (localtime_r(&t, &local) == 0) {
+            return 0;
+        }
+        return static_cast<int32_t>(local.tm_gmtoff);
+#endif
+    }
+
+    int32_t utc_offset(int64_t utcSeconds)
+    {
+        int64_t minute = time_format_detail::floor_div(utcSeconds, 60);
+        if (minute != offsetMinute_) {
+            offset_ = lookup_utc_offset(utcSeconds);
+            offsetMinute_ = minute;
+        }
+        return offset_;
+    }
+
+    static void render_date(RenderedSecond& rendered, int64_t day)
+    {
+        static const char weekdays[] = "SunMonTueWedThuFriSat";
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+        int year;
+        unsigned int month;
+        unsigned int dayOfMonth;
+        time_format_detail::civil_from_days(day, year, month, dayOfMonth);
+        unsigned int weekday = static_cast<unsigned int>(((day + 4) % 7 + 7) % 7);   // 1970-01-01 was a Thursday
+        uint32_t fourDigitYear = static_cast<uint32_t>(year < 0 ? 0 : (year > 9999 ? 9999 : year));
+
+        char* c = rendered.ctime;
+        std::memcpy(c, weekdays + 3 * weekday, 3);
+        c[3] = ' ';
+        std::memcpy(c + 4, months + 3 * (month - 1), 3);
+        c[7] = ' ';
+        std::memcpy(c + 8, time_format_detail::two_digits(dayOfMonth), 2);
+        if (c[8] == '0') {
+            c[8] = ' ';
+        }
+        c[10] = ' ';
+        c[13] = ':';
+        c[16] = ':';
+        c[19] = ' ';
+        time_format_detail::write_digits(c + 20, fourDigitYear, 4);
+        c[24] = '\n';
+
+        char* r = rendered.rfc3339;
+        time_format_detail::write_digits(r, fourDigitYear, 4);
+        r[4] = '-';
+        std::memcpy(r + 5, time_format_detail::two_digits(month), 2);
+        r[7] = '-';
+        std::memcpy(r + 8, time_format_detail::two_digits(dayOfMonth), 2);
+        r[10] = 'T';
+        r[13] = ':';
+        r[16] = ':';
+    }
+
+    static void render(RenderedSecond& rendered, int64_t second)
+    {
+        if (second == rendered.second) {
+            return;
+        }
+
+        int64_t day = time_format_detail::floor_div(second, 86400);
+        if (day != rendered.day) {
+            render_date(rendered, day);
+            rendered.day = day;
+        }
+
+        unsigned int secondOfDay = static_cast<unsigned int>(second - day * 86400);
+        const char* hours = time_format_detail::two_digits(secondOfDay / 3600);
+        const char* minutes = time_format_detail::two_digits(secondOfDay / 60 % 60);
+        const char* seconds = time_format_detail::two_digits(secondOfDay % 60);
+        char* targets[] = { rendered.ctime, rendered.rfc3339 };
+        for (int i = 0; i < 2; ++i) {
+            std::memcpy(targets[i] + 11, hours, 2);
+            std::memcpy(targets[i] + 14, minutes, 2);
+            std::memcpy(targets[i] + 17, seconds, 2);
+        }
+        rendered.second = second;
+    }
+
+public:
+    TimeFormatter() :
+        offsetMinute_(INT64_MIN),
+        offset_(0)
+    {
+    }
+
+    static TimeFormatter& this_thread()
+    {
+        static thread_local TimeFormatter formatter;
+        return formatter;
+    }
+
+    // writes time into buffer (at least max_length bytes) and returns the number of bytes written;
+    // zone is ignored by time_format_rfc868, which is UTC by definition
+    size_t format(const WallTime& time, TimeFormat format, TimeZone zone, char* buffer)
+    {
+        if (format == time_format_rfc868) {
+            uint32_t value = static_cast<uint32_t>(static_cast<uint64_t>(time.seconds + rfc868_epoch_offset));
+            buffer[0] = char(value >> 24);
+            buffer[1] = char(value >> 16);
+            buffer[2] = char(value >> 8);
+            buffer[3] = char(value);
+            return 4;
+        }
+
+        int32_t offset = zone == time_zone_local ? utc_offset(time.seconds) : 0;
+        RenderedSecond& rendered = zone == time_zone_local ? local_ : utc_;
+        render(rendered, time.seconds + offset);
+
+        if (format == time_format_ctime) {
+            std::memcpy(buffer, rendered.ctime, ctime_length);
+            return ctime_length;
+        }
+
+        std::memcpy(buffer, rendered.rfc3339, rfc3339_length);
+        size_t length = rfc3339_length;
+        if (format == time_format_rfc3339_micro) {
+            buffer[length++] = '.';
+            time_format_detail::write_digits(buffer + length, time.nanoseconds / 1000, 6);
+            length += 6;
+        }
+        else if (format == time_format_rfc3339_nano) {
+            buffer[length++] = '.';
+            time_format_detail::write_digits(buffer + length, time.nanoseconds, 9);
+            length += 9;
+        }
+
+        if (zone == time_zone_utc) {
+            buffer[length++] = 'Z';
+        }
+        else {
+            unsigned int offsetMinutes = static_cast<unsigned int>((offset < 0 ? -offset : offset) / 60);
+            buffer[length++] = offset < 0 ? '-' : '+';
+            std::memcpy(buffer + length, time_format_detail::two_digits(offsetMinutes / 60 % 100), 2);
+            buffer[length + 2] = ':';
+            std::memcpy(buffer + length + 3, time_format_detail::two_digits(offsetMinutes % 60), 2);
+            length += 5;
+        }
+        return length;
+    }
+
+    size_t format_now(TimeFormat format, TimeZone zone, TimeSource source, char* buffer)
+    {
+        return this->format(read_wall_clock(source), format, zone, buffer);
+    }
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+// adaptive receive path for stream sockets
+
+// a fixed 128-byte read_some() loop costs one system call per 128 bytes, plus a copy of every chunk;
+// AdaptiveReceiver sizes every read from the reads before it (AdaptiveReadSize) and reads straight into
+// where the bytes are going:
+//   receive_into(stream, dynamicBuffer): into a caller's DynamicBuffer (prepare / commit, no staging copy)
+//   receive_into(stream, span):          into a caller's fixed memory, until EOF or until it is full
+//   receive(stream, onData):             into the receiver's own buffer, onData gets a view of each read,
+//                                        valid only until it returns (streaming, nothing is copied)
+// all three read until the peer closes the connection (EOF is success) and count their reads in stats()
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+
+// grows the next read when a read filled its buffer (more is probably waiting in the socket),
+// shrinks it after two reads in a row used a quarter of it or less (one short read is often just the tail)
+class AdaptiveReadSize {
+public:
+    enum {
+        default_minimum = 512,
+        default_initial = 4096,
+        default_maximum = 1024 * 1024
+    };
+
+private:
+    size_t    minimum_;
+    size_t    maximum_;
+    size_t    next_;
+    bool      shrinkPending_;
+
+public:
+    AdaptiveReadSize(size_t minimum = default_minimum,
+                     size_t initial = default_initial,
+                     size_t maximum = default_maximum) :
+        minimum_(minimum < 1 ? 1 : minimum),
+        maximum_(maximum < minimum_ ? minimum_ : maximum),
+        next_(initial < minimum_ ? minimum_ : (initial > maximum_ ? maximum_ : initial)),
+        shrinkPending_(false)
+    {
+    }
+
+    size_t next() const
+    {
+        return next_;
+    }
+
+    // called with the number of bytes every read returned
+    void record(size_t bytesRead)
+    {
+        if (bytesRead >= next_) {
+            next_ = next_ * 2 < maximum_ ? next_ * 2 : maximum_;
+            shrinkPending_ = false;
+        }
+        else if (bytesRead <= next_ / 4) {
+            if (shrinkPending_) {
+                next_ = next_ / 2 > minimum_ ? next_ / 2 : minimum_;
+            }
+            shrinkPending_ = !shrinkPending_;
+        }
+        else {
+            shrinkPending_ = false;
+        }
+    }
+};
+
+
+struct ReceiveStats {
+    uint64_t    reads;          // read_some() calls, i.e. recv() system calls
+    uint64_t    bytes;
+    size_t      largestRead;
+
+    ReceiveStats() :
+        reads(0),
+        bytes(0),
+        largestRead(0)
+    {
+    }
+};
+
+
+class AdaptiveReceiver {
+private:
+    AdaptiveReadSize     readSize_;
+    ReceiveStats         stats_;
+    std::vector<char>    buffer_;       // streaming mode only
+
+    void record(size_t bytesRead)
+    {
+        readSize_.record(bytesRead);
+        ++stats_.reads;
+        stats_.bytes += bytesRead;
+        if (bytesRead > stats_.largestRead) {
+            stats_.largestRead = bytesRead;
+        }
+    }
+
+    // EOF ends every receive successfully
+    static bool finished(boost::system::error_code& errorCode)
+    {
+        if (errorCode == boost::asio::error::eof) {
+            errorCode = boost::system::error_code();
+            return true;
+        }
+        return bool(errorCode);
+    }
+
+public:
+    explicit AdaptiveReceiver(const AdaptiveReadSize& readSize = AdaptiveReadSize()) :
+        readSize_(readSize)
+    {
+    }
+
+    const ReceiveStats& stats() const
+    {
+        return stats_;
+    }
+
+    const AdaptiveReadSize& read_size() const
+    {
+        return readSize_;
+    }
+
+    // appends everything up to EOF to buffer (a boost::asio::streambuf, or boost::asio::dynamic_buffer(...)
+    // over a std::string or std::vector); returns the number of bytes appended
+    template <typename SyncReadStream, typename DynamicBuffer>
+    size_t receive_into(SyncReadStream& stream, DynamicBuffer&& buffer, boost::system::error_code& errorCode)
+    {
+        size_t received = 0;
+        for (;;) {
+            size_t room = buffer.max_size() - buffer.size();
+            if (room == 0) {
+                errorCode = boost::asio::error::no_buffer_space;
+                return received;
+            }
+            size_t wanted = readSize_.next() < room ? readSize_.next() : room;
+
+            size_t n = stream.read_some(buffer.prepare(wanted), errorCode);
+            buffer.commit(n);
+            record(n);
+            received += n;
+
+            if (finished(errorCode)) {
+                return received;
+            }
+        }
+    }
+
+    // fills span up to EOF; no_buffer_space if the peer has more to send than fits
+    template <typename SyncReadStream>
+    size_t receive_into(SyncReadStream& stream, boost::asio::mutable_buffer span, boost::system::error_code& errorCode)
+    {
+        size_t received = 0;
+        for (;;) {
+            if (received == span.size()) {
+                // a zero-length read would tell EOF from "more data" only by blocking, so peek one byte
+                char probe;
+                size_t n = stream.read_some(boost::asio::buffer(&probe, 1), errorCode);
+                ++stats_.reads;
+                if (errorCode == boost::asio::error::eof) {
+                    errorCode = boost::system::error_code();
+                }
+                else if (n > 0) {
+                    errorCode = boost::asio::error::no_buffer_space;
+                }
+                return received;
+            }
+
+            size_t n = stream.read_some(span + received, errorCode);
+            record(n);
+            received += n;
+
+            if (finished(errorCode)) {
+                return received;
+            }
+        }
+    }
+
+    // calls onData(boost::asio::const_buffer) with every read up to EOF; the view points into the
+    // receiver's own buffer and is only valid until onData returns; returns the number of bytes received
+    template <typename SyncReadStream, typename DataHandler>
+    size_t receive(SyncReadStream& stream, DataHandler onData, boost::system::error_code& errorCode)
+    {
+        size_t received = 0;
+        for (;;) {
+            size_t wanted = readSize_.next();
+            if (buffer_.size() < wanted || buffer_.size() > 4 * wanted) {
+                // give memory back once the reads got much smaller than the buffer
+                std::vector<char>(wanted).swap(buffer_);
+            }
+
+            size_t n = stream.read_some(boost::asio::buffer(&buffer_[0], wanted), errorCode);
+            record(n);
+            received += n;
+            if (n > 0) {
+                onData(boost::asio::const_buffer(&buffer_[0], n));
+            }
+
+            if (finished(errorCode)) {
+                return received;
+            }
+        }
+    }
+};
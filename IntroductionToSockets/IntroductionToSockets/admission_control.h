@@ -0,0 +1,105 @@
+#pragma once
+
+// admission control for TcpServer: a connection limit and an accept-rate token bucket
+
+// a server that accepts and starts every connection keeps taking on work after it is saturated,
+// so queues, memory and latency grow for everybody; with admission control a connection beyond the
+// limits is either never accepted (the acceptor stops re-arming async_accept, excess connections wait
+// in the kernel backlog) or accepted and closed at once with an abortive close (no response, no
+// TIME_WAIT on the server), so clients get a fast, cheap "no" and admitted connections keep their latency
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+
+enum OverloadPolicy {
+    overload_pause_accept,      // stop accepting until there is room again
+    overload_reject             // accept, then close right away (RST)
+};
+
+
+// rate = 0 means unlimited; burst is how many tokens can pile up while the server is idle
+class TokenBucket {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+private:
+    double               rate_;
+    double               burst_;
+    double               tokens_;
+    Clock::time_point    last_;
+
+    void refill(Clock::time_point now)
+    {
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+        last_ = now;
+    }
+
+public:
+    TokenBucket(double rate, double burst) :
+        rate_(rate),
+        burst_(std::max(burst, 1.0)),
+        tokens_(std::max(burst, 1.0)),
+        last_(Clock::now())
+    {
+    }
+
+    bool unlimited() const
+    {
+        return rate_ <= 0;
+    }
+
+    bool available()
+    {
+        if (unlimited()) {
+            return true;
+        }
+        refill(Clock::now());
+        return tokens_ >= 1;
+    }
+
+    bool try_take()
+    {
+        if (!available()) {
+            return false;
+        }
+        if (!unlimited()) {
+            tokens_ -= 1;
+        }
+        return true;
+    }
+
+    // how long until the next token is there (zero if one is available now)
+    Clock::duration time_until_available()
+    {
+        if (available()) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1 - tokens_) / rate_));
+    }
+};
+
+
+// live counters of one server, safe to read from any thread
+struct TcpServerStats {
+    uint64_t    accepted;       // connections admitted and served
+    uint64_t    shed;           // connections closed right after accept by admission control
+    uint64_t    active;         // connections currently being served
+
+    TcpServerStats() :
+        accepted(0),
+        shed(0),
+        active(0)
+    {
+    }
+
+    TcpServerStats& operator+=(const TcpServerStats& other)
+    {
+        accepted += other.accepted;
+        shed += other.shed;
+        active += other.active;
+        return *this;
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+// a per-endpoint pool of connected sockets that a client borrows and gives back
+
+// a client that talks to the same server again and again pays a TCP handshake (and a TIME_WAIT) per
+// request if it connects every time; ConnectionPool keeps the sockets of finished requests open, per
+// remote endpoint, and hands them to the next request for that endpoint:
+//   - at most maxIdlePerEndpoint idle sockets per endpoint, the rest are closed when they are released
+//   - an idle socket older than maxIdleTime is closed instead of being handed out
+//   - every socket is health-checked before it is handed out: an idle connection must have nothing to read,
+//     EOF means the server closed it (e.g. its idle timeout), data means it sent something nobody asked for
+//   - prefill() connects sockets ahead of the first request
+//   - new connections race the endpoints (Happy Eyeballs), so one dead address does not stall the pool
+// a socket that failed in any way must not be released, just dropped (closing it is the caller's business)
+// not thread-safe: used from the thread that runs its io_context
+// the idle sockets are shared with the prefill connects in flight, which only hold a weak pointer to them:
+// a connect that completes after the pool is gone closes its socket; an acquire that completes after
+// the pool is gone still hands its socket to the caller, it never touches the pool
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "happy_eyeballs.h"
+
+
+struct ConnectionPoolStats {
+    uint64_t    connects;       // new connections
+    uint64_t    reused;         // handed out from the pool
+    uint64_t    discarded;      // idle sockets found dead or expired
+    uint64_t    evicted;        // released sockets closed because the pool was full
+
+    ConnectionPoolStats() :
+        connects(0),
+        reused(0),
+        discarded(0),
+        evicted(0)
+    {
+    }
+};
+
+
+class ConnectionPool {
+public:
+    typedef boost::asio::ip::tcp                                                    tcp;
+    typedef std::chrono::steady_clock                                               Clock;
+    typedef boost::shared_ptr<tcp::socket>                                          SocketPtr;
+    typedef std::function<void(const boost::system::error_code&, const SocketPtr&)> AcquireHandler;
+
+private:
+    struct IdleSocket {
+        SocketPtr            socket;
+        Clock::time_point    since;
+    };
+
+    typedef std::deque<IdleSocket> IdleSockets;     // oldest first
+
+    // what a prefill connect in flight gives its socket to when it completes
+    struct Idle {
+        size_t                                  maxPerEndpoint;
+        Clock::duration                         maxTime;
+        std::map<tcp::endpoint, IdleSockets>    sockets;
+        ConnectionPoolStats                     stats;
+
+        Idle(size_t maxPerEndpoint, Clock::duration maxTime) :
+            maxPerEndpoint(maxPerEndpoint),
+            maxTime(maxTime)
+        {
+        }
+    };
+
+    boost::asio::io_context&                io_context_;
+    Clock::duration                         connectTimeout_;
+    boost::shared_ptr<Idle>                 idle_;
+
+    static bool healthy(tcp::socket& socket)
+    {
+        if (!socket.is_open()) {
+            return false;
+        }
+
+        // peek without blocking: would_block is the only good answer
+        boost::system::error_code errorCode;
+        char probe;
+        socket.non_blocking(true, errorCode);
+        socket.receive(boost::asio::buffer(&probe, 1), tcp::socket::message_peek, errorCode);
+        bool alive = (errorCode == boost::asio::error::would_block);
+        socket.non_blocking(false, errorCode);
+        return alive;
+    }
+
+    static void close(tcp::socket& socket)
+    {
+        boost::system::error_code ignored;
+        socket.close(ignored);
+    }
+
+    // the newest idle socket for endpoint that is still usable, or a null pointer
+    SocketPtr take_idle(const tcp::endpoint& endpoint)
+    {
+        std::map<tcp::endpoint, IdleSockets>::iterator it = idle_->sockets.find(endpoint);
+        if (it == idle_->sockets.end()) {
+            return SocketPtr();
+        }
+
+        IdleSockets& sockets = it->second;
+        Clock::time_point now = Clock::now();
+        while (!sockets.empty()) {
+            IdleSocket idle = sockets.back();
+            sockets.pop_back();
+
+            if (now - idle.since <= idle_->maxTime && healthy(*idle.socket)) {
+                return idle.socket;
+            }
+            close(*idle.socket);
+            ++idle_->stats.discarded;
+        }
+        return SocketPtr();
+    }
+
+    static void add_idle(Idle& idle, const SocketPtr& socket)
+    {
+        boost::system::error_code errorCode;
+        tcp::endpoint endpoint = socket->remote_endpoint(errorCode);
+        if (errorCode) {
+            close(*socket);
+            return;
+        }
+
+        IdleSockets& sockets = idle.sockets[endpoint];
+
+        // expired sockets are at the front
+        Clock::time_point now = Clock::now();
+        while (!sockets.empty() && now - sockets.front().since > idle.maxTime) {
+            close(*sockets.front().socket);
+            sockets.pop_front();
+            ++idle.stats.discarded;
+        }
+
+        if (sockets.size() >= idle.maxPerEndpoint) {
+            close(*socket);
+            ++idle.stats.evicted;
+            return;
+        }
+
+        IdleSocket idleSocket = { socket, now };
+        sockets.push_back(idleSocket);
+    }
+
+    static void handle_prefill(const boost::weak_ptr<Idle>& weakIdle,
+                               const SocketPtr& socket,
+                               const boost::system::error_code& errorCode)
+    {
+        boost::shared_ptr<Idle> idle = weakIdle.lock();
+        if (!idle) {
+            // the ConnectionPool has been destroyed
+            close(*socket);
+            return;
+        }
+        if (!errorCode) {
+            add_idle(*idle, socket);
+        }
+    }
+
+public:
+    ConnectionPool(boost::asio::io_context& io_context,
+                   size_t maxIdlePerEndpoint = 8,
+                   Clock::duration maxIdleTime = std::chrono::seconds(30),
+                   Clock::duration connectTimeout = std::chrono::seconds(10)) :
+        io_context_(io_context),
+        connectTimeout_(connectTimeout),
+        idle_(new Idle(maxIdlePerEndpoint, maxIdleTime))
+    {
+    }
+
+    // an idle socket to one of endpoints (in their order), or else the first new connection of the race
+    // across endpoints; timed_out if none connects within connectTimeout
+    void async_acquire(const tcp::resolver::results_type& endpoints, const AcquireHandler& handler)
+    {
+        for (tcp::resolver::results_type::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+            SocketPtr socket = take_idle(it->endpoint());
+            if (socket) {
+                ++idle_->stats.reused;
+                boost::asio::post(io_context_, boost::bind(handler, boost::system::error_code(), socket));
+                return;
+            }
+        }
+
+        // the connected socket goes straight to the caller, the pool is not involved any more
+        ++idle_->stats.connects;
+        async_happy_eyeballs_connect(io_context_,
+                                     endpoints,
+                                     std::chrono::milliseconds(HappyEyeballsConnector::default_attempt_delay_ms),
+                                     connectTimeout_,
+                                     handler);
+    }
+
+    // gives a socket back after a request completed cleanly
+    void release(const SocketPtr& socket)
+    {
+        add_idle(*idle_, socket);
+    }
+
+    // connects count sockets to endpoint in the background and adds them to the pool
+    void prefill(const tcp::endpoint& endpoint, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            ++idle_->stats.connects;
+            SocketPtr socket(new tcp::socket(io_context_));
+            socket->async_connect(endpoint,
+                                  boost::bind(&ConnectionPool::handle_prefill, boost::weak_ptr<Idle>(idle_), socket,
+                                              boost::asio::placeholders::error));
+        }
+    }
+
+    size_t idle_count(const tcp::endpoint& endpoint) const
+    {
+        std::map<tcp::endpoint, IdleSockets>::const_iterator it = idle_->sockets.find(endpoint);
+        return it == idle_->sockets.end() ? 0 : it->second.size();
+    }
+
+    const ConnectionPoolStats& stats() const
+    {
+        return idle_->stats;
+    }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+// slab (pool) allocator for connection objects
+
+// connection objects are carved out of big slabs instead of being new'ed one by one;
+// a destroyed connection goes back to a free list and the next accepted connection reuses its memory,
+// the slabs themselves are only given back to the system when the io_context is destroyed
+
+// ConnectionSlab is an io_context service: use_service<ConnectionSlab>(io_context) returns the slab of that
+// io_context, and because services are destroyed after the io_context has destroyed all pending handlers,
+// connections still referenced by those handlers are always released into a slab that still exists
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+
+class ConnectionSlab : public boost::asio::detail::execution_context_service_base<ConnectionSlab> {
+private:
+    enum {
+        nodes_per_slab = 1024
+    };
+
+    struct FreeNode {
+        FreeNode*    next;
+    };
+
+    // uncontended when the io_context is run by a single thread (the multi-core server's shards),
+    // but keeps the slab correct when several threads run the same io_context
+    std::mutex              mutex_;
+    size_t                  nodeSize_;
+    std::vector<char*>      slabs_;
+    FreeNode*               freeNodes_;
+    size_t                  liveNodes_;
+
+    // connections that have been started (are being served), as opposed to the ones still waiting in
+    // async_accept or held back by admission control; counted here and not in the server, because
+    // connections may be released after their server is gone
+    std::atomic<size_t>     servedConnections_;
+
+    static size_t round_up(size_t size)
+    {
+        const size_t alignment = alignof(std::max_align_t);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void grow()
+    {
+        char* slab = static_cast<char*>(::operator new(nodeSize_ * nodes_per_slab));
+        slabs_.push_back(slab);
+
+        for (size_t i = nodes_per_slab; i > 0; --i) {
+            FreeNode* node = reinterpret_cast<FreeNode*>(slab + (i - 1) * nodeSize_);
+            node->next = freeNodes_;
+            freeNodes_ = node;
+        }
+    }
+
+public:
+    explicit ConnectionSlab(boost::asio::execution_context& context) :
+        boost::asio::detail::execution_context_service_base<ConnectionSlab>(context),
+        nodeSize_(0),
+        freeNodes_(0),
+        liveNodes_(0),
+        servedConnections_(0)
+    {
+    }
+
+    ~ConnectionSlab()
+    {
+        for (size_t i = 0; i < slabs_.size(); ++i) {
+            ::operator delete(slabs_[i]);
+        }
+    }
+
+    void shutdown()
+    {
+    }
+
+    // all nodes of a slab have the size of the first object allocated from it
+    void* allocate(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (nodeSize_ == 0) {
+            nodeSize_ = round_up(size < sizeof(FreeNode) ? sizeof(FreeNode) : size);
+        }
+        if (size > nodeSize_) {
+            throw std::bad_alloc();
+        }
+        if (!freeNodes_) {
+            grow();
+        }
+
+        FreeNode* node = freeNodes_;
+        freeNodes_ = node->next;
+        ++liveNodes_;
+        return node;
+    }
+
+    void deallocate(void* pointer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        FreeNode* node = static_cast<FreeNode*>(pointer);
+        node->next = freeNodes_;
+        freeNodes_ = node;
+        --liveNodes_;
+    }
+
+    size_t node_size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nodeSize_;
+    }
+
+    size_t live()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return liveNodes_;
+    }
+
+    void connection_served()
+    {
+        servedConnections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void connection_finished()
+    {
+        servedConnections_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    size_t served() const
+    {
+        return servedConnections_.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slabs_.size() * nodes_per_slab;
+    }
+
+    size_t reserved_bytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slabs_.size() * nodes_per_slab * nodeSize_;
+    }
+};
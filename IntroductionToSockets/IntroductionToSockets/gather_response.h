@@ -0,0 +1,241 @@
+#pragma once
+
+// scatter-gather response assembly and a coalescing write queue
+
+// a GatherResponse is a list of pieces that are written with one gather write (writev) instead of being
+// concatenated into a fresh string first:
+//   add_static():   bytes that outlive every write (string literals, static tables), referenced, never copied
+//   add_shared():   a cached segment shared by many responses (e.g. the current daytime string), kept
+//                   alive by the response until it has been written
+//   add_fragment(): per-request bytes, copied into the response itself
+// pieces are stored as (source, offset, size) and only turned into const_buffers when written, so a
+// GatherResponse can be moved around (e.g. inside a std::vector) without invalidating anything
+//
+// CoalescingWriteQueue collects the responses of one connection: while a write is in flight new responses
+// wait, and when it completes all waiting responses go out together in the next single async_write
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+class GatherResponse {
+public:
+    typedef boost::shared_ptr<const std::string> SharedSegment;
+
+    enum {
+        max_pieces          = 8,
+        max_shared_segments = 4
+    };
+
+private:
+    enum Source {
+        static_source,
+        shared_source,
+        fragment_source
+    };
+
+    struct Piece {
+        Source         source;
+        const char*    data;       // static_source only
+        size_t         index;      // shared_source: index into shared_; fragment_source: offset into fragments_
+        size_t         size;
+    };
+
+    boost::array<Piece, max_pieces>                        pieces_;
+    size_t                                                 pieceCount_;
+    boost::array<SharedSegment, max_shared_segments>       shared_;
+    size_t                                                 sharedCount_;
+    std::string                                            fragments_;
+    size_t                                                 bytes_;
+
+    void add_piece(Source source, const char* data, size_t index, size_t size)
+    {
+        if (pieceCount_ == max_pieces) {
+            throw std::length_error("GatherResponse: too many pieces");
+        }
+        Piece piece = { source, data, index, size };
+        pieces_[pieceCount_++] = piece;
+        bytes_ += size;
+    }
+
+public:
+    GatherResponse() :
+        pieceCount_(0),
+        sharedCount_(0),
+        bytes_(0)
+    {
+    }
+
+    template <size_t N>
+    GatherResponse& add_static(const char (&literal)[N])
+    {
+        add_piece(static_source, literal, 0, N - 1);
+        return *this;
+    }
+
+    GatherResponse& add_static(const char* data, size_t size)
+    {
+        add_piece(static_source, data, 0, size);
+        return *this;
+    }
+
+    GatherResponse& add_shared(const SharedSegment& segment)
+    {
+        if (sharedCount_ == max_shared_segments) {
+            throw std::length_error("GatherResponse: too many shared segments");
+        }
+        add_piece(shared_source, 0, sharedCount_, segment->size());
+        shared_[sharedCount_++] = segment;
+        return *this;
+    }
+
+    GatherResponse& add_fragment(const char* data, size_t size)
+    {
+        add_piece(fragment_source, 0, fragments_.size(), size);
+        fragments_.append(data, size);
+        return *this;
+    }
+
+    GatherResponse& add_fragment(const std::string& fragment)
+    {
+        return add_fragment(fragment.data(), fragment.size());
+    }
+
+    // total number of bytes
+    size_t size() const
+    {
+        return bytes_;
+    }
+
+    size_t piece_count() const
+    {
+        return pieceCount_;
+    }
+
+    // appends one const_buffer per piece; valid as long as this response is neither changed nor moved
+    void append_buffers(std::vector<boost::asio::const_buffer>& buffers) const
+    {
+        for (size_t i = 0; i < pieceCount_; ++i) {
+            const Piece& piece = pieces_[i];
+            switch (piece.source) {
+            case static_source:
+                buffers.push_back(boost::asio::const_buffer(piece.data, piece.size));
+                break;
+            case shared_source:
+                buffers.push_back(boost::asio::buffer(*shared_[piece.index]));
+                break;
+            case fragment_source:
+                buffers.push_back(boost::asio::const_buffer(fragments_.data() + piece.index, piece.size));
+                break;
+            }
+        }
+    }
+};
+
+
+// a view of buffers owned by someone else: an Asio ConstBufferSequence that is cheap to copy
+// (async_write keeps a copy of its buffer sequence, a std::vector would be copied with it)
+class GatherBuffers {
+private:
+    const boost::asio::const_buffer*    begin_;
+    const boost::asio::const_buffer*    end_;
+
+public:
+    typedef boost::asio::const_buffer          value_type;
+    typedef const boost::asio::const_buffer*   const_iterator;
+
+    GatherBuffers(const std::vector<boost::asio::const_buffer>& buffers) :
+        begin_(buffers.empty() ? 0 : &buffers[0]),
+        end_(buffers.empty() ? 0 : &buffers[0] + buffers.size())
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return begin_;
+    }
+
+    const_iterator end() const
+    {
+        return end_;
+    }
+};
+
+
+// not thread-safe: used by one connection, from the handlers of that connection
+class CoalescingWriteQueue {
+public:
+    // writev() takes at most IOV_MAX (1024 on Linux) buffers, and Asio hands at most 64 to one call
+    enum { max_buffers_per_write = 64 };
+
+private:
+    std::vector<GatherResponse>                  pending_;
+    std::vector<GatherResponse>                  inFlight_;
+    std::vector<boost::asio::const_buffer>       buffers_;
+
+public:
+    // returns true if no write is in flight, i.e. the caller has to start one with next_write()
+    bool push(GatherResponse response)
+    {
+        pending_.push_back(std::move(response));
+        return inFlight_.empty() && pending_.size() == 1;
+    }
+
+    bool writing() const
+    {
+        return !inFlight_.empty();
+    }
+
+    size_t pending() const
+    {
+        return pending_.size();
+    }
+
+    // moves as many waiting responses as fit into one gather write and returns their buffers;
+    // the buffers stay valid until write_completed()
+    GatherBuffers next_write()
+    {
+        inFlight_.clear();
+        buffers_.clear();
+
+        size_t taken = 0;
+        size_t bufferCount = 0;
+        while (taken < pending_.size()) {
+            size_t pieces = pending_[taken].piece_count();
+            if (taken > 0 && bufferCount + pieces > max_buffers_per_write) {
+                break;
+            }
+            bufferCount += pieces;
+            ++taken;
+        }
+
+        inFlight_.assign(std::make_move_iterator(pending_.begin()), std::make_move_iterator(pending_.begin() + taken));
+        pending_.erase(pending_.begin(), pending_.begin() + taken);
+
+        for (size_t i = 0; i < inFlight_.size(); ++i) {
+            inFlight_[i].append_buffers(buffers_);
+        }
+        return buffers_;
+    }
+
+    // returns true if more responses are waiting, i.e. the caller has to start the next write
+    bool write_completed()
+    {
+        inFlight_.clear();
+        buffers_.clear();
+        return !pending_.empty();
+    }
+
+    size_t responses_in_flight() const
+    {
+        return inFlight_.size();
+    }
+};
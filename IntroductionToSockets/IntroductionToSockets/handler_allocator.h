@@ -0,0 +1,194 @@
+#pragma once
+
+// recycling memory for the operation state Asio allocates for every async_* call
+
+// Asio allocates one block for each pending asynchronous operation (the operation object holding a copy
+// of the completion handler) and frees it right before the handler is invoked;
+// it asks the handler for an allocator through the associated-allocator customization point
+// (a nested allocator_type + get_allocator()), so wrapping a handler in RecyclingHandler
+// routes that block through HandlerMemoryCache instead of the heap
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+
+// per-thread cache of memory blocks, bucketed by size class;
+// a block freed by a completed operation goes back to the cache of the thread that frees it
+// and is handed to the next operation of the same size class, so once every size class is warm
+// an accept / write cycle does not call malloc at all
+class HandlerMemoryCache : private boost::noncopyable {
+private:
+    enum {
+        smallest_block    = 128,    // size classes: 128, 256, 512, 1024 bytes
+        size_classes      = 4,
+        max_cached_blocks = 64      // per size class and thread, the rest goes back to the heap
+    };
+
+    struct FreeBlock {
+        FreeBlock*    next;
+    };
+
+    FreeBlock*    freeBlocks_[size_classes];
+    size_t        cachedBlocks_[size_classes];
+
+    // only counts trips to the heap, so the fast path stays free of shared atomics
+    static std::atomic<unsigned long>& heap_allocation_counter()
+    {
+        static std::atomic<unsigned long> counter(0);
+        return counter;
+    }
+
+    static int size_class(size_t size)
+    {
+        size_t blockSize = smallest_block;
+        for (int i = 0; i < size_classes; ++i, blockSize *= 2) {
+            if (size <= blockSize) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    HandlerMemoryCache()
+    {
+        for (int i = 0; i < size_classes; ++i) {
+            freeBlocks_[i] = 0;
+            cachedBlocks_[i] = 0;
+        }
+    }
+
+public:
+    ~HandlerMemoryCache()
+    {
+        for (int i = 0; i < size_classes; ++i) {
+            while (freeBlocks_[i]) {
+                FreeBlock* block = freeBlocks_[i];
+                freeBlocks_[i] = block->next;
+                ::operator delete(block);
+            }
+        }
+    }
+
+    static HandlerMemoryCache& this_thread()
+    {
+        static thread_local HandlerMemoryCache cache;
+        return cache;
+    }
+
+    // number of blocks any thread had to get from the heap so far (cache misses and oversized blocks)
+    static unsigned long heap_allocations()
+    {
+        return heap_allocation_counter().load(std::memory_order_relaxed);
+    }
+
+    void* allocate(size_t size)
+    {
+        int sizeClass = size_class(size);
+
+        if (sizeClass >= 0 && freeBlocks_[sizeClass]) {
+            FreeBlock* block = freeBlocks_[sizeClass];
+            freeBlocks_[sizeClass] = block->next;
+            --cachedBlocks_[sizeClass];
+            return block;
+        }
+
+        heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(sizeClass >= 0 ? size_t(smallest_block) << sizeClass : size);
+    }
+
+    void deallocate(void* pointer, size_t size)
+    {
+        int sizeClass = size_class(size);
+
+        if (sizeClass >= 0 && cachedBlocks_[sizeClass] < max_cached_blocks) {
+            FreeBlock* block = static_cast<FreeBlock*>(pointer);
+            block->next = freeBlocks_[sizeClass];
+            freeBlocks_[sizeClass] = block;
+            ++cachedBlocks_[sizeClass];
+            return;
+        }
+
+        ::operator delete(pointer);
+    }
+};
+
+
+// stateless allocator on top of the calling thread's HandlerMemoryCache
+template <typename T>
+class RecyclingAllocator {
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef RecyclingAllocator<U> other;
+    };
+
+    RecyclingAllocator()
+    {
+    }
+
+    template <typename U>
+    RecyclingAllocator(const RecyclingAllocator<U>& /*other*/)
+    {
+    }
+
+    T* allocate(size_t n) const
+    {
+        return static_cast<T*>(HandlerMemoryCache::this_thread().allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* pointer, size_t n) const
+    {
+        HandlerMemoryCache::this_thread().deallocate(pointer, sizeof(T) * n);
+    }
+
+    template <typename U>
+    bool operator==(const RecyclingAllocator<U>& /*other*/) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const RecyclingAllocator<U>& /*other*/) const
+    {
+        return false;
+    }
+};
+
+
+// completion handler wrapper that tells Asio to use RecyclingAllocator for the operation state
+template <typename Handler>
+class RecyclingHandler {
+private:
+    Handler    handler_;
+
+public:
+    typedef RecyclingAllocator<Handler> allocator_type;
+
+    explicit RecyclingHandler(const Handler& handler) :
+        handler_(handler)
+    {
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type();
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+};
+
+template <typename Handler>
+inline RecyclingHandler<Handler> make_recycling_handler(const Handler& handler)
+{
+    return RecyclingHandler<Handler>(handler);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+// Happy Eyeballs connect (RFC 8305): race the resolved endpoints instead of trying them one by one
+
+// boost::asio::connect(socket, endpoints) tries the endpoints strictly in sequence, so one address that never
+// answers (a blackholed IPv6 route, a host whose SYNs are dropped) costs the full kernel connect timeout,
+// minutes, before the next address is even tried; HappyEyeballsConnector instead
+//   - orders the endpoints alternating between address families, the family of the first one first
+//   - starts the next attempt when the previous one has not connected after attemptDelay (250 ms
+//     recommended by RFC 8305), or right away when it failed, and keeps the earlier attempts running
+//   - takes the first attempt that connects and closes all the others
+//   - gives up with timed_out when nothing connected before the deadline
+// the handler is called exactly once, with the connected socket or with the last error
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+class HappyEyeballsConnector : public boost::enable_shared_from_this<HappyEyeballsConnector> {
+public:
+    typedef boost::asio::ip::tcp                                                    tcp;
+    typedef boost::shared_ptr<tcp::socket>                                          SocketPtr;
+    typedef std::function<void(const boost::system::error_code&, const SocketPtr&)> ConnectHandler;
+
+    enum { default_attempt_delay_ms = 250 };
+
+private:
+    boost::asio::io_context&                io_context_;
+    std::vector<tcp::endpoint>              endpoints_;
+    std::vector<SocketPtr>                  attempts_;
+    size_t                                  nextAttempt_;
+    size_t                                  failedAttempts_;
+    boost::asio::steady_timer::duration     attemptDelay_;
+    boost::asio::steady_timer::duration     deadline_;
+    boost::asio::steady_timer               attemptTimer_;
+    boost::asio::steady_timer               deadlineTimer_;
+    ConnectHandler                          handler_;
+    bool                                    done_;
+    boost::system::error_code               lastError_;
+
+    void start_next_attempt()
+    {
+        size_t index = nextAttempt_++;
+        attempts_[index].reset(new tcp::socket(io_context_));
+        attempts_[index]->async_connect(endpoints_[index],
+                                        boost::bind(&HappyEyeballsConnector::handle_connect,
+                                                    shared_from_this(),
+                                                    index,
+                                                    boost::asio::placeholders::error));
+
+        if (nextAttempt_ < endpoints_.size()) {
+            attemptTimer_.expires_after(attemptDelay_);
+            attemptTimer_.async_wait(boost::bind(&HappyEyeballsConnector::handle_attempt_timer,
+                                                 shared_from_this(),
+                                                 nextAttempt_,
+                                                 boost::asio::placeholders::error));
+        }
+    }
+
+    // expectedAttempt guards against a timer that had already fired when a failure started that attempt
+    void handle_attempt_timer(size_t expectedAttempt, const boost::system::error_code& errorCode)
+    {
+        if (errorCode || done_ || nextAttempt_ != expectedAttempt) {
+            return;
+        }
+        start_next_attempt();
+    }
+
+    void handle_connect(size_t index, const boost::system::error_code& errorCode)
+    {
+        if (done_) {
+            // a losing attempt, closed by finish()
+            return;
+        }
+        if (!errorCode) {
+            finish(errorCode, attempts_[index]);
+            return;
+        }
+
+        lastError_ = errorCode;
+        close(attempts_[index]);
+
+        if (++failedAttempts_ == endpoints_.size()) {
+            finish(lastError_, SocketPtr());
+        }
+        else if (nextAttempt_ < endpoints_.size()) {
+            // no reason to wait out the delay
+            attemptTimer_.cancel();
+            start_next_attempt();
+        }
+    }
+
+    void handle_deadline(const boost::system::error_code& errorCode)
+    {
+        if (errorCode || done_) {
+            return;
+        }
+        finish(boost::asio::error::timed_out, SocketPtr());
+    }
+
+    void finish(const boost::system::error_code& errorCode, const SocketPtr& winner)
+    {
+        done_ = true;
+        attemptTimer_.cancel();
+        deadlineTimer_.cancel();
+
+        for (size_t i = 0; i < attempts_.size(); ++i) {
+            if (attempts_[i] && attempts_[i] != winner) {
+                close(attempts_[i]);
+            }
+        }
+        handler_(errorCode, winner);
+    }
+
+    static void close(const SocketPtr& socket)
+    {
+        boost::system::error_code ignored;
+        socket->close(ignored);
+    }
+
+public:
+    HappyEyeballsConnector(boost::asio::io_context& io_context,
+                           const std::vector<tcp::endpoint>& endpoints,
+                           boost::asio::steady_timer::duration attemptDelay,
+                           boost::asio::steady_timer::duration deadline,
+                           const ConnectHandler& handler) :
+        io_context_(io_context),
+        endpoints_(interleave_address_families(endpoints)),
+        attempts_(endpoints_.size()),
+        nextAttempt_(0),
+        failedAttempts_(0),
+        attemptDelay_(attemptDelay),
+        deadline_(deadline),
+        attemptTimer_(io_context),
+        deadlineTimer_(io_context),
+        handler_(handler),
+        done_(false)
+    {
+    }
+
+    void start()
+    {
+        if (endpoints_.empty()) {
+            done_ = true;
+            boost::asio::post(io_context_, boost::bind(handler_, boost::asio::error::host_not_found, SocketPtr()));
+            return;
+        }
+
+        deadlineTimer_.expires_after(deadline_);
+        deadlineTimer_.async_wait(boost::bind(&HappyEyeballsConnector::handle_deadline,
+                                              shared_from_this(),
+                                              boost::asio::placeholders::error));
+        start_next_attempt();
+    }
+
+    // RFC 8305 section 4: alternate between the families, starting with the family of the first endpoint
+    static std::vector<tcp::endpoint> interleave_address_families(const std::vector<tcp::endpoint>& endpoints)
+    {
+        if (endpoints.empty()) {
+            return endpoints;
+        }
+
+        bool firstIsV6 = endpoints[0].address().is_v6();
+        std::vector<tcp::endpoint> preferred;
+        std::vector<tcp::endpoint> other;
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            (endpoints[i].address().is_v6() == firstIsV6 ? preferred : other).push_back(endpoints[i]);
+        }
+
+        std::vector<tcp::endpoint> ordered;
+        for (size_t i = 0; i < preferred.size() || i < other.size(); ++i) {
+            if (i < preferred.size()) {
+                ordered.push_back(preferred[i]);
+            }
+            if (i < other.size()) {
+                ordered.push_back(other[i]);
+            }
+        }
+        return ordered;
+    }
+};
+
+
+inline void async_happy_eyeballs_connect(boost::asio::io_context& io_context,
+                                         const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+                                         boost::asio::steady_timer::duration attemptDelay,
+                                         boost::asio::steady_timer::duration deadline,
+                                         const HappyEyeballsConnector::ConnectHandler& handler)
+{
+    boost::make_shared<HappyEyeballsConnector>(boost::ref(io_context), endpoints, attemptDelay, deadline, handler)->start();
+}
+
+inline void async_happy_eyeballs_connect(boost::asio::io_context& io_context,
+                                         const boost::asio::ip::tcp::resolver::results_type& endpoints,
+                                         boost::asio::steady_timer::duration attemptDelay,
+                                         boost::asio::steady_timer::duration deadline,
+                                         const HappyEyeballsConnector::ConnectHandler& handler)
+{
+    std::vector<boost::asio::ip::tcp::endpoint> list;
+    for (boost::asio::ip::tcp::resolver::results_type::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+        list.push_back(it->endpoint());
+    }
+    async_happy_eyeballs_connect(io_context, list, attemptDelay, deadline, handler);
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+// asynchronous load generator for the daytime servers
+
+// same path as the synchronous client (resolve, connect, read until EOF), but asynchronous,
+// non-interactive and with thousands of connections in flight:
+//   open loop:   new connections are started at a fixed rate, whether or not earlier ones have finished
+//                (latency is measured from the moment a connection was due, so a stalled server cannot
+//                hide its queueing delay by slowing the generator down)
+//   closed loop: a fixed number of connections is kept in flight, each finished one starts the next
+// connect latency, first-byte latency and total (until EOF) latency go into LatencyHistograms
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "latency_histogram.h"
+
+
+struct LoadGeneratorConfig {
+    std::string     host;
+    std::string     service;                // port number or service name
+    bool            openLoop;
+    double          connectionsPerSecond;   // open loop: target rate
+    unsigned int    maxInFlight;            // open loop: connections due while this many are in flight are dropped
+    unsigned int    concurrency;            // closed loop: connections kept in flight
+    double          seconds;                // how long new connections are started
+    double          drainSeconds;           // how long to wait for in-flight connections afterwards
+
+    LoadGeneratorConfig() :
+        host("127.0.0.1"),
+        service("13"),
+        openLoop(false),
+        connectionsPerSecond(1000),
+        maxInFlight(10000),
+        concurrency(100),
+        seconds(5),
+        drainSeconds(5)
+    {
+    }
+};
+
+
+struct LoadGeneratorReport {
+    LatencyHistogram    connectLatency;
+    LatencyHistogram    firstByteLatency;
+    LatencyHistogram    totalLatency;
+    unsigned long       completed;
+    unsigned long       failed;
+    unsigned long       dropped;        // open loop only: not started because maxInFlight was reached
+    double              elapsedSeconds;
+
+    LoadGeneratorReport() :
+        completed(0),
+        failed(0),
+        dropped(0),
+        elapsedSeconds(0)
+    {
+    }
+
+    double connections_per_second() const
+    {
+        return elapsedSeconds > 0 ? completed / elapsedSeconds : 0;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "[load generator] completed=" << completed << " failed=" << failed << " dropped=" << dropped
+           << " elapsed=" << elapsedSeconds << "s connections/sec=" << connections_per_second() << "\n";
+        os << "[load generator] connect     ";
+        connectLatency.print_summary(os);
+        os << "\n[load generator] first byte  ";
+        firstByteLatency.print_summary(os);
+        os << "\n[load generator] until EOF   ";
+        totalLatency.print_summary(os);
+        os << std::endl;
+    }
+};
+
+
+class LoadGenerator {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+private:
+    typedef boost::asio::ip::tcp tcp;
+
+    // one daytime query: connect, read until EOF
+    class Probe : public boost::enable_shared_from_this<Probe> {
+    private:
+        LoadGenerator*             generator_;
+        tcp::socket                socket_;
+        boost::array<char, 128>    buf_;
+        Clock::time_point          due_;
+        bool                       gotFirstByte_;
+
+        void handle_connect(const boost::system::error_code& errorCode)
+        {
+            if (errorCode) {
+                generator_->probe_finished(false, due_);
+                return;
+            }
+            generator_->report_.connectLatency.record(since(due_));
+            start_read();
+        }
+
+        void start_read()
+        {
+            socket_.async_read_some(boost::asio::buffer(buf_),
+                                    boost::bind(&Probe::handle_read,
+                                                shared_from_this(),
+                                                boost::asio::placeholders::error));
+        }
+
+        void handle_read(const boost::system::error_code& errorCode)
+        {
+            if (!errorCode) {
+                if (!gotFirstByte_) {
+                    gotFirstByte_ = true;
+                    generator_->report_.firstByteLatency.record(since(due_));
+                }
+                start_read();
+                return;
+            }
+            generator_->probe_finished(errorCode == boost::asio::error::eof && gotFirstByte_, due_);
+        }
+
+    public:
+        Probe(LoadGenerator* generator, Clock::time_point due) :
+            generator_(generator),
+            socket_(generator->io_context_),
+            due_(due),
+            gotFirstByte_(false)
+        {
+        }
+
+        void start(const tcp::resolver::results_type& endpoints)
+        {
+            boost::asio::async_connect(socket_,
+                                       endpoints,
+                                       boost::bind(&Probe::handle_connect,
+                                                   shared_from_this(),
+                                                   boost::asio::placeholders::error));
+        }
+    };
+
+    boost::asio::io_context&            io_context_;
+    LoadGeneratorConfig                 config_;
+    tcp::resolver                       resolver_;
+    tcp::resolver::results_type         endpoints_;
+    boost::asio::steady_timer           pacer_;
+    boost::asio::steady_timer           deadline_;
+    Clock::time_point                   begin_;
+    Clock::time_point                   end_;
+    unsigned long                       started_;
+    unsigned long                       inFlight_;
+    bool                                generating_;
+    LoadGeneratorReport                 report_;
+
+    static uint64_t since(Clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    void handle_resolve(const boost::system::error_code& errorCode,
+                        const tcp::resolver::results_type& endpoints)
+    {
+        if (errorCode) {
+            std::cout << "[load generator] cannot resolve " << config_.host << ":" << config_.service
+                      << ": " << errorCode.message() << std::endl;
+            return;
+        }
+        endpoints_ = endpoints;
+
+        begin_ = Clock::now();
+        end_ = begin_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config_.seconds));
+        generating_ = true;
+
+        deadline_.expires_at(end_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config_.drainSeconds)));
+        deadline_.async_wait(boost::bind(&LoadGenerator::handle_deadline, this, boost::asio::placeholders::error));
+
+        if (config_.openLoop) {
+            pace();
+        }
+        else {
+            for (unsigned int i = 0; i < config_.concurrency; ++i) {
+                start_probe(Clock::now());
+            }
+        }
+    }
+
+    void start_probe(Clock::time_point due)
+    {
+        ++started_;
+        ++inFlight_;
+        boost::shared_ptr<Probe> probe(new Probe(this, due));
+        probe->start(endpoints_);
+    }
+
+    // open loop: every millisecond start all connections that are due by now
+    void pace()
+    {
+        Clock::time_point now = Clock::now();
+        if (now >= end_) {
+            stop_generating();
+            return;
+        }
+
+        double elapsed = std::chrono::duration<double>(now - begin_).count();
+        unsigned long due = static_cast<unsigned long>(elapsed * config_.connectionsPerSecond);
+
+        while (started_ + report_.dropped < due) {
+            // the moment this connection should have started, latency is measured from there
+            Clock::time_point dueTime = begin_ + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((started_ + report_.dropped) / config_.connectionsPerSecond));
+
+            if (inFlight_ >= config_.maxInFlight) {
+                ++report_.dropped;
+            }
+            else {
+                start_probe(dueTime);
+            }
+        }
+
+        pacer_.expires_after(std::chrono::milliseconds(1));
+        pacer_.async_wait(boost::bind(&LoadGenerator::pace, this));
+    }
+
+    void probe_finished(bool succeeded, Clock::time_point due)
+    {
+        --inFlight_;
+
+        if (succeeded) {
+            ++report_.completed;
+            report_.totalLatency.record(since(due));
+        }
+        else {
+            ++report_.failed;
+        }
+
+        if (generating_ && Clock::now() >= end_) {
+            stop_generating();
+        }
+
+        if (generating_ && !config_.openLoop) {
+            start_probe(Clock::now());
+        }
+        else if (!generating_ && inFlight_ == 0) {
+            deadline_.cancel();
+        }
+    }
+
+    void stop_generating()
+    {
+        if (!generating_) {
+            return;
+        }
+        generating_ = false;
+        report_.elapsedSeconds = std::chrono::duration<double>(Clock::now() - begin_).count();
+
+        if (inFlight_ == 0) {
+            deadline_.cancel();
+        }
+    }
+
+    void handle_deadline(const boost::system::error_code& errorCode)
+    {
+        if (errorCode) {
+            // cancelled: every connection finished in time
+            return;
+        }
+        // connections that did not finish within the drain time count as failed
+        stop_generating();
+        report_.failed += inFlight_;
+        inFlight_ = 0;
+        io_context_.stop();
+    }
+
+public:
+    LoadGenerator(boost::asio::io_context& io_context, const LoadGeneratorConfig& config) :
+        io_context_(io_context),
+        config_(config),
+        resolver_(io_context),
+        pacer_(io_context),
+        deadline_(io_context),
+        started_(0),
+        inFlight_(0),
+        generating_(false)
+    {
+    }
+
+    void start()
+    {
+        resolver_.async_resolve(config_.host,
+                                config_.service,
+                                boost::bind(&LoadGenerator::handle_resolve,
+                                            this,
+                                            boost::asio::placeholders::error,
+                                            boost::asio::placeholders::results));
+    }
+
+    const LoadGeneratorReport& report() const
+    {
+        return report_;
+    }
+};
+
+
+// run a complete load test on its own io_context and return what it measured
+inline LoadGeneratorReport run_load_generator(const LoadGeneratorConfig& config)
+{
+    boost::asio::io_context io_context;
+    LoadGenerator generator(io_context, config);
+    generator.start();
+    io_context.run();
+    return generator.report();
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+// asynchronous resolver cache with a TTL and negative caching
+
+// a client that polls the same servers again and again resolves the same names again and again;
+// ResolverCache keeps every answer for ttl, and every failure (e.g. host_not_found) for negativeTtl,
+// so a name that does not resolve does not cost a lookup per request either
+// lookups of a name that is already being resolved wait for that lookup instead of starting another one
+// getaddrinfo() does not report the TTL of the DNS records, so the TTLs are the cache's own
+// the lookup behind the cache is tcp::resolver::async_resolve, or any Lookup function (a stub in tests)
+// not thread-safe: used from the thread that runs its io_context; handlers are always posted, never
+// called from inside async_resolve()
+// the entries are shared with the lookups in flight, which only hold a weak pointer to them: a lookup that
+// completes after the cache is gone finds nothing to update, and its waiting handlers are never called
+// expired entries are dropped on the way, at most once per TTL, so names that are not asked for again do
+// not stay in the cache forever
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+
+struct ResolverCacheStats {
+    uint64_t    lookups;        // calls to the lookup behind the cache
+    uint64_t    hits;           // answered from the cache, results
+    uint64_t    negativeHits;   // answered from the cache, an error
+    uint64_t    joined;         // waited for a lookup that was already running
+    uint64_t    evicted;        // expired entries dropped
+
+    ResolverCacheStats() :
+        lookups(0),
+        hits(0),
+        negativeHits(0),
+        joined(0),
+        evicted(0)
+    {
+    }
+};
+
+
+class ResolverCache {
+public:
+    typedef boost::asio::ip::tcp                                    tcp;
+    typedef std::chrono::steady_clock                               Clock;
+    typedef std::function<void(const boost::system::error_code&, const tcp::resolver::results_type&)>
+                                                                    ResolveHandler;
+    typedef std::function<void(const std::string&, const std::string&, const ResolveHandler&)>
+                                                                    Lookup;
+
+private:
+    typedef std::pair<std::string, std::string> Key;     // host, service
+
+    struct Entry {
+        bool                                resolving;
+        boost::system::error_code           error;
+        tcp::resolver::results_type         results;
+        Clock::time_point                   expires;
+        std::vector<ResolveHandler>         waiting;
+
+        Entry() :
+            resolving(false)
+        {
+        }
+    };
+
+    // what a lookup in flight updates when it completes
+    struct Entries {
+        Clock::duration             ttl;
+        Clock::duration             negativeTtl;
+        std::map<Key, Entry>        entries;
+        ResolverCacheStats          stats;
+
+        Entries(Clock::duration ttl, Clock::duration negativeTtl) :
+            ttl(ttl),
+            negativeTtl(negativeTtl)
+        {
+        }
+    };
+
+    boost::asio::io_context&    io_context_;
+    tcp::resolver               resolver_;
+    Lookup                      lookup_;
+    boost::shared_ptr<Entries>  cache_;
+    Clock::time_point           nextEviction_;
+
+    void system_lookup(const std::string& host, const std::string& service, const ResolveHandler& handler)
+    {
+        resolver_.async_resolve(host, service,
+                                boost::bind(&invoke, handler,
+                                            boost::asio::placeholders::error,
+                                            boost::asio::placeholders::results));
+    }
+
+    static void invoke(const ResolveHandler& handler,
+                       const boost::system::error_code& errorCode,
+                       const tcp::resolver::results_type& results)
+    {
+        handler(errorCode, results);
+    }
+
+    static void handle_lookup(const boost::weak_ptr<Entries>& weakCache,
+                              const Key& key,
+                              const boost::system::error_code& errorCode,
+                              const tcp::resolver::results_type& results)
+    {
+        boost::shared_ptr<Entries> cache = weakCache.lock();
+        if (!cache) {
+            // the ResolverCache has been destroyed
+            return;
+        }
+        std::map<Key, Entry>::iterator it = cache->entries.find(key);
+        if (it == cache->entries.end()) {
+            return;
+        }
+        Entry& entry = it->second;
+
+        entry.resolving = false;
+        entry.error = errorCode;
+        entry.results = results;
+        entry.expires = Clock::now() + (errorCode ? cache->negativeTtl : cache->ttl);
+
+        std::vector<ResolveHandler> waiting;
+        waiting.swap(entry.waiting);
+        for (size_t i = 0; i < waiting.size(); ++i) {
+            waiting[i](errorCode, results);
+        }
+    }
+
+    // a full pass over the entries, so only once per TTL
+    void evict_expired(Clock::time_point now)
+    {
+        if (now < nextEviction_) {
+            return;
+        }
+        nextEviction_ = now + std::min(cache_->ttl, cache_->negativeTtl);
+
+        std::map<Key, Entry>& entries = cache_->entries;
+        for (std::map<Key, Entry>::iterator it = entries.begin(); it != entries.end(); ) {
+            if (!it->second.resolving && it->second.expires <= now) {
+                it = entries.erase(it);
+                ++cache_->stats.evicted;
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+public:
+    ResolverCache(boost::asio::io_context& io_context,
+                  Clock::duration ttl = std::chrono::seconds(30),
+                  Clock::duration negativeTtl = std::chrono::seconds(5)) :
+        io_context_(io_context),
+        resolver_(io_context),
+        cache_(new Entries(ttl, negativeTtl)),
+        nextEviction_(Clock::now())
+    {
+        lookup_ = boost::bind(&ResolverCache::system_lookup, this, _1, _2, _3);
+    }
+
+    ResolverCache(boost::asio::io_context& io_context,
+                  const Lookup& lookup,
+                  Clock::duration ttl = std::chrono::seconds(30),
+                  Clock::duration negativeTtl = std::chrono::seconds(5)) :
+        io_context_(io_context),
+        resolver_(io_context),
+        lookup_(lookup),
+        cache_(new Entries(ttl, negativeTtl)),
+        nextEviction_(Clock::now())
+    {
+    }
+
+    ~ResolverCache()
+    {
+        resolver_.cancel();
+    }
+
+    void async_resolve(const std::string& host, const std::string& service, const ResolveHandler& handler)
+    {
+        Clock::time_point now = Clock::now();
+        evict_expired(now);
+
+        Key key(host, service);
+        std::map<Key, Entry>& entries = cache_->entries;
+        std::map<Key, Entry>::iterator it = entries.find(key);
+
+        if (it != entries.end()) {
+            Entry& entry = it->second;
+            if (entry.resolving) {
+                ++cache_->stats.joined;
+                entry.waiting.push_back(handler);
+                return;
+            }
+            if (now < entry.expires) {
+                ++(entry.error ? cache_->stats.negativeHits : cache_->stats.hits);
+                boost::asio::post(io_context_, boost::bind(&invoke, handler, entry.error, entry.results));
+                return;
+            }
+        }
+        else {
+            it = entries.insert(std::make_pair(key, Entry())).first;
+        }
+
+        // missing or expired
+        Entry& entry = it->second;
+        entry.resolving = true;
+        entry.waiting.push_back(handler);
+
+        ++cache_->stats.lookups;
+        lookup_(host, service, boost::bind(&ResolverCache::handle_lookup, boost::weak_ptr<Entries>(cache_), key, _1, _2));
+    }
+
+    // drops every entry that is not being resolved right now
+    void clear()
+    {
+        std::map<Key, Entry>& entries = cache_->entries;
+        for (std::map<Key, Entry>::iterator it = entries.begin(); it != entries.end(); ) {
+            if (it->second.resolving) {
+                ++it;
+            }
+            else {
+                it = entries.erase(it);
+            }
+        }
+    }
+
+    // entries cached or being resolved
+    size_t size() const
+    {
+        return cache_->entries.size();
+    }
+
+    const ResolverCacheStats& stats() const
+    {
+        return cache_->stats;
+    }
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+// synchronous daytime server on a fixed pool of threads, with a bounded handoff queue and send timeouts
+
+// the synchronous server of Example 2 serves one connection at a time, so one client that reads slowly
+// (or not at all, once the response no longer fits into the socket buffers) stalls everybody behind it;
+// SyncDaytimeServer keeps the blocking accept / write code, but on several threads:
+//   workerThreads == 0:  acceptThreads threads all block in accept() on the shared acceptor (the kernel wakes
+//                        one of them per connection), and each serves the connection it accepted itself
+//   workerThreads > 0:   the accepting threads only accept, and hand every connection to a bounded queue that
+//                        workerThreads threads serve; when the queue is full, overload_pause_accept blocks the
+//                        accepting thread (new connections wait in the kernel backlog), overload_reject closes
+//                        the connection right away (RST)
+// every response is written with a send timeout (SO_SNDTIMEO), so a reader that stops reading costs a
+// thread for at most sendTimeout instead of forever
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "admission_control.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <cerrno>
+#endif
+
+
+// SO_SNDTIMEO on a connected socket; zero means no timeout
+inline void set_send_timeout(boost::asio::ip::tcp::socket& socket, std::chrono::milliseconds timeout,
+                             boost::system::error_code& errorCode)
+{
+#if defined(_WIN32)
+    DWORD milliseconds = static_cast<DWORD>(timeout.count());
+    int result = ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_SNDTIMEO,
+                              reinterpret_cast<const char*>(&milliseconds), sizeof milliseconds);
+    errorCode = result == 0 ? boost::system::error_code()
+                            : boost::system::error_code(::WSAGetLastError(), boost::system::system_category());
+#else
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+    int result = ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+    errorCode = result == 0 ? boost::system::error_code()
+                            : boost::system::error_code(errno, boost::system::system_category());
+#endif
+}
+
+// writes all of data with plain send() calls, so that SO_SNDTIMEO applies: boost::asio::write() on a blocking
+// socket treats the timeout's EAGAIN like a non-blocking socket's and waits in poll() without a timeout;
+// timed_out if the peer did not take the data in time (part of it may have been sent)
+inline size_t send_with_timeout(boost::asio::ip::tcp::socket& socket, const char* data, size_t size,
+                                boost::system::error_code& errorCode)
+{
+    size_t sent = 0;
+    errorCode = boost::system::error_code();
+    while (sent < size) {
+#if defined(_WIN32)
+        int n = ::send(socket.native_handle(), data + sent, static_cast<int>(size - sent), 0);
+        if (n == SOCKET_ERROR) {
+            int error = ::WSAGetLastError();
+            errorCode = error == WSAETIMEDOUT ? boost::system::error_code(boost::asio::error::timed_out)
+                                              : boost::system::error_code(error, boost::system::system_category());
+            return sent;
+        }
+#else
+#if defined(MSG_NOSIGNAL)
+        ssize_t n = ::send(socket.native_handle(), data + sent, size - sent, MSG_NOSIGNAL);
+#else
+        ssize_t n = ::send(socket.native_handle(), data + sent, size - sent, 0);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorCode = (errno == EAGAIN || errno == EWOULDBLOCK)
+                        ? boost::system::error_code(boost::asio::error::timed_out)
+                        : boost::system::error_code(errno, boost::system::system_category());
+            return sent;
+        }
+#endif
+        sent += static_cast<size_t>(n);
+    }
+    return sent;
+}
+
+
+// blocking queue with a fixed capacity, closed once by the consumer side's owner
+template <typename T>
+class BoundedQueue : private boost::noncopyable {
+private:
+    std::mutex                 mutex_;
+    std::condition_variable    notEmpty_;
+    std::condition_variable    notFull_;
+    std::deque<T>              items_;
+    size_t                     capacity_;
+    bool                       closed_;
+
+public:
+    explicit BoundedQueue(size_t capacity) :
+        capacity_(capacity < 1 ? 1 : capacity),
+        closed_(false)
+    {
+    }
+
+    // wait = false: fail at once when the queue is full; always fails once the queue is closed
+    bool push(T&& item, bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!closed_ && items_.size() >= capacity_) {
+            if (!wait) {
+                return false;
+            }
+            notFull_.wait(lock);
+        }
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // false once the queue is closed and empty
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!closed_ && items_.empty()) {
+            notEmpty_.wait(lock);
+        }
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // pop() still returns what was queued before
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+};
+
+
+struct SyncServerConfig {
+    unsigned short               port;              // 0 = let the OS pick a free port
+    unsigned int                 acceptThreads;     // threads blocking in accept() on the shared acceptor
+    unsigned int                 workerThreads;     // 0 = the accepting threads serve their connections themselves
+    size_t                       queueCapacity;     // connections accepted but not yet picked up by a worker
+    OverloadPolicy               overloadPolicy;    // what an accepting thread does when the queue is full
+    std::chrono::milliseconds    sendTimeout;       // 0 = no timeout
+    int                          sendBufferSize;    // SO_SNDBUF of every connection, 0 = the system's (Linux grows
+                                                    // it with the congestion window, to megabytes on loopback)
+
+    SyncServerConfig() :
+        port(13),
+        acceptThreads(1),
+        workerThreads(0),
+        queueCapacity(64),
+        overloadPolicy(overload_pause_accept),
+        sendTimeout(1000),
+        sendBufferSize(0)
+    {
+    }
+};
+
+
+struct SyncServerStats {
+    uint64_t    accepted;
+    uint64_t    served;         // response written completely
+    uint64_t    timedOut;       // the client did not read the response within the send timeout
+    uint64_t    shed;           // closed at once because the queue was full (overload_reject)
+};
+
+
+class SyncDaytimeServer : private boost::noncopyable {
+public:
+    typedef boost::asio::ip::tcp              tcp;
+    typedef std::function<std::string()>      ResponseFunction;
+
+private:
+    SyncServerConfig                       config_;
+    ResponseFunction                       response_;
+    boost::asio::io_context                io_context_;     // never run, sockets only need one to exist
+    tcp::acceptor                          acceptor_;
+    BoundedQueue<tcp::socket>              queue_;
+    boost::thread_group                    acceptThreads_;
+    boost::thread_group                    workerThreads_;
+    std::atomic<bool>                      running_;
+    std::atomic<uint64_t>                  accepted_;
+    std::atomic<uint64_t>                  served_;
+    std::atomic<uint64_t>                  timedOut_;
+    std::atomic<uint64_t>                  shed_;
+
+    void accept_loop()
+    {
+        for (;;) {
+            tcp::socket socket(io_context_);
+            boost::system::error_code errorCode;
+            acceptor_.accept(socket, errorCode);
+
+            if (!running_.load(std::memory_order_acquire)) {
+                // woken up by stop()
+                return;
+            }
+            if (errorCode) {
+                // e.g. the client reset the connection before it was accepted
+                continue;
+            }
+            accepted_.fetch_add(1, std::memory_order_relaxed);
+
+            if (config_.workerThreads == 0) {
+                serve(socket);
+            }
+            else if (!queue_.push(std::move(socket), config_.overloadPolicy == overload_pause_accept)) {
+                // the queue is full (overload_reject) or closing; push() only moves the socket on success
+                reject(socket);
+            }
+        }
+    }
+
+    void worker_loop()
+    {
+        tcp::socket socket(io_context_);
+        while (queue_.pop(socket)) {
+            serve(socket);
+        }
+    }
+
+    void serve(tcp::socket& socket)
+    {
+        boost::system::error_code errorCode;
+        if (config_.sendTimeout.count() > 0) {
+            set_send_timeout(socket, config_.sendTimeout, errorCode);
+        }
+        if (config_.sendBufferSize > 0) {
+            socket.set_option(tcp::socket::send_buffer_size(config_.sendBufferSize), errorCode);
+        }
+
+        std::string message = response_();
+        send_with_timeout(socket, message.data(), message.size(), errorCode);
+
+        if (!errorCode) {
+            served_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (errorCode == boost::asio::error::timed_out) {
+            timedOut_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        boost::system::error_code ignored;
+        if (errorCode) {
+            // do not leave the unsent rest in the socket buffer for the kernel to keep retrying
+            socket.set_option(tcp::socket::linger(true, 0), ignored);
+        }
+        socket.close(ignored);
+    }
+
+    void reject(tcp::socket& socket)
+    {
+        boost::system::error_code ignored;
+        socket.set_option(tcp::socket::linger(true, 0), ignored);
+        socket.close(ignored);
+        shed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    SyncDaytimeServer(const SyncServerConfig& config, const ResponseFunction& response) :
+        config_(config),
+        response_(response),
+        acceptor_(io_context_),
+        queue_(config.queueCapacity),
+        running_(false),
+        accepted_(0),
+        served_(0),
+        timedOut_(0),
+        shed_(0)
+    {
+        if (config_.acceptThreads == 0) {
+            config_.acceptThreads = 1;
+        }
+
+        tcp::endpoint endpoint(tcp::v4(), config.port);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+    }
+
+    ~SyncDaytimeServer()
+    {
+        stop();
+    }
+
+    unsigned short port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+
+    void start()
+    {
+        if (running_.exchange(true)) {
+            return;
+        }
+        for (unsigned int i = 0; i < config_.workerThreads; ++i) {
+            workerThreads_.create_thread(boost::bind(&SyncDaytimeServer::worker_loop, this));
+        }
+        for (unsigned int i = 0; i < config_.acceptThreads; ++i) {
+            acceptThreads_.create_thread(boost::bind(&SyncDaytimeServer::accept_loop, this));
+        }
+    }
+
+    // serves what is already queued, then returns with every thread joined
+    void stop()
+    {
+        if (!running_.exchange(false)) {
+            return;
+        }
+
+        // an accepting thread waiting in push() on a full queue (overload_pause_accept) would never get back
+        // to accept(): close the queue first, push() then fails at once; pop() still returns what was queued
+        queue_.close();
+
+        // closing the acceptor does not reliably wake a thread blocked in accept(), a connection does:
+        // one per accepting thread, each accept returns once and its thread sees running_ == false
+        tcp::endpoint self(boost::asio::ip::address_v4::loopback(), port());
+        std::vector<tcp::socket> wakeUps;
+        wakeUps.reserve(config_.acceptThreads);
+        for (unsigned int i = 0; i < config_.acceptThreads; ++i) {
+            wakeUps.emplace_back(io_context_);
+            boost::system::error_code ignored;
+            wakeUps.back().connect(self, ignored);
+        }
+        acceptThreads_.join_all();
+        workerThreads_.join_all();
+
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+    }
+
+    // may be called from any thread
+    SyncServerStats stats() const
+    {
+        SyncServerStats stats;
+        stats.accepted = accepted_.load(std::memory_order_relaxed);
+        stats.served = served_.load(std::memory_order_relaxed);
+        stats.timedOut = timedOut_.load(std::memory_order_relaxed);
+        stats.shed = shed_.load(std::memory_order_relaxed);
+        return stats;
+    }
+};
@@ -0,0 +1,662 @@
+#pragma once
+
+// binary time service over UDP and TCP, stamped with the kernel's receive timestamps (SO_TIMESTAMPNS)
+
+// a daytime answer says what time it was when the server got around to formatting it, to the second;
+// a time service reply carries nanoseconds since the Unix epoch: the client's transmit time (echoed), the time
+// the request was received and the time the reply was sent; with the client's own receive time those are the
+// four timestamps NTP works with:
+//   round trip:    (client receive - client transmit) - (server transmit - server receive)
+//   clock offset:  ((server receive - client transmit) + (server transmit - client receive)) / 2, server ahead > 0
+// server transmit - server receive is how long the request waited in the server: in the socket buffer, in
+// the io_context queue behind other handlers, and in the handler itself (recorded as metric_receive_to_reply)
+// with SO_TIMESTAMPNS (Linux) recvmsg() returns the time the kernel received the packet; over TCP that is the
+// time of the last segment the read returned, so requests pipelined into one read share it; elsewhere, or
+// when disabled, the receive time is read when the read returns (time_reply_kernel_receive_stamp not set),
+// which hides every wait before that read
+// wire format, every integer big endian:
+//   request, 16 bytes:  "TIME", sequence (u32), client transmit (i64)
+//   reply, 40 bytes:    "TIME", sequence (u32), flags (u32), reserved (u32), client transmit (i64),
+//                       server receive (i64), server transmit (i64)
+// over TCP a connection carries any number of requests back to back, answered in order
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "runtime_metrics.h"
+#include "time_formatter.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#endif
+
+
+enum {
+    time_request_size   = 16,
+    time_reply_size     = 40
+};
+
+enum TimeReplyFlags {
+    time_reply_kernel_receive_stamp = 1
+};
+
+enum TimeServiceTransport {
+    time_service_udp,
+    time_service_tcp
+};
+
+struct TimeRequest {
+    uint32_t    sequence;
+    int64_t     clientTransmit;
+};
+
+struct TimeReply {
+    uint32_t    sequence;
+    uint32_t    flags;
+    int64_t     clientTransmit;
+    int64_t     serverReceive;
+    int64_t     serverTransmit;
+};
+
+
+namespace time_service_detail {
+
+const uint32_t magic = 0x54494D45;     // "TIME"
+
+inline void put_u32(char* out, uint32_t value)
+{
+    out[0] = char(value >> 24);
+    out[1] = char(value >> 16);
+    out[2] = char(value >> 8);
+    out[3] = char(value);
+}
+
+inline void put_i64(char* out, int64_t value)
+{
+    put_u32(out, static_cast<uint32_t>(static_cast<uint64_t>(value) >> 32));
+    put_u32(out + 4, static_cast<uint32_t>(value));
+}
+
+inline uint32_t get_u32(const char* in)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+    return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]);
+}
+
+inline int64_t get_i64(const char* in)
+{
+    return static_cast<int64_t>(uint64_t(get_u32(in)) << 32 | get_u32(in + 4));
+}
+
+inline boost::system::error_code last_error()
+{
+#if defined(_WIN32)
+    int error = ::WSAGetLastError();
+    if (error == WSAEWOULDBLOCK || error == WSAETIMEDOUT) {
+        return boost::asio::error::would_block;
+    }
+    return boost::system::error_code(error, boost::system::system_category());
+#else
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return boost::asio::error::would_block;
+    }
+    return boost::system::error_code(errno, boost::system::system_category());
+#endif
+}
+
+} // namespace time_service_detail
+
+
+inline void encode_time_request(const TimeRequest& request, char* out)
+{
+    time_service_detail::put_u32(out, time_service_detail::magic);
+    time_service_detail::put_u32(out + 4, request.sequence);
+    time_service_detail::put_i64(out + 8, request.clientTransmit);
+}
+
+inline bool decode_time_request(const char* in, TimeRequest& request)
+{
+    if (time_service_detail::get_u32(in) != time_service_detail::magic) {
+        return false;
+    }
+    request.sequence = time_service_detail::get_u32(in + 4);
+    request.clientTransmit = time_service_detail::get_i64(in + 8);
+    return true;
+}
+
+inline void encode_time_reply(const TimeReply& reply, char* out)
+{
+    time_service_detail::put_u32(out, time_service_detail::magic);
+    time_service_detail::put_u32(out + 4, reply.sequence);
+    time_service_detail::put_u32(out + 8, reply.flags);
+    time_service_detail::put_u32(out + 12, 0);
+    time_service_detail::put_i64(out + 16, reply.clientTransmit);
+    time_service_detail::put_i64(out + 24, reply.serverReceive);
+    time_service_detail::put_i64(out + 32, reply.serverTransmit);
+}
+
+inline bool decode_time_reply(const char* in, TimeReply& reply)
+{
+    if (time_service_detail::get_u32(in) != time_service_detail::magic) {
+        return false;
+    }
+    reply.sequence = time_service_detail::get_u32(in + 4);
+    reply.flags = time_service_detail::get_u32(in + 8);
+    reply.clientTransmit = time_service_detail::get_i64(in + 16);
+    reply.serverReceive = time_service_detail::get_i64(in + 24);
+    reply.serverTransmit = time_service_detail::get_i64(in + 32);
+    return true;
+}
+
+
+// nanoseconds since the Unix epoch, the precise clock (see time_formatter.h)
+inline int64_t wall_clock_nanoseconds()
+{
+    WallTime now = read_wall_clock(time_source_precise);
+    return now.seconds * 1000000000 + now.nanoseconds;
+}
+
+// asks the kernel to timestamp every packet the socket receives; false where it cannot
+template <typename Socket>
+bool enable_receive_timestamps(Socket& socket)
+{
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+    int on = 1;
+    return ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof on) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+// SO_RCVTIMEO, for the receive_stamped() calls of a blocking socket; they then fail with would_block
+template <typename Socket>
+void set_receive_timeout(Socket& socket, std::chrono::milliseconds timeout, boost::system::error_code& errorCode)
+{
+#if defined(_WIN32)
+    DWORD milliseconds = static_cast<DWORD>(timeout.count());
+    int result = ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO,
+                              reinterpret_cast<const char*>(&milliseconds), sizeof milliseconds);
+#else
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+    int result = ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+#endif
+    errorCode = result == 0 ? boost::system::error_code() : time_service_detail::last_error();
+}
+
+
+struct ReceiveStamp {
+    int64_t     nanoseconds;    // since the Unix epoch
+    bool        kernel;         // taken by the kernel when the packet arrived, not when the read returned
+};
+
+// one plain receive on the socket in whatever mode it is in (non-blocking, or blocking with SO_RCVTIMEO):
+// would_block when there is nothing (in time); for a stream socket 0 bytes and no error is the end of the stream
+template <typename Socket, typename Endpoint>
+size_t receive_stamped(Socket& socket, boost::asio::mutable_buffer buffer, Endpoint* sender,
+                       ReceiveStamp& stamp, boost::system::error_code& errorCode)
+{
+#if defined(__linux__)
+    iovec iov;
+    iov.iov_base = buffer.data();
+    iov.iov_len = buffer.size();
+
+    union {
+        char       buffer[CMSG_SPACE(sizeof(timespec))];
+        cmsghdr    align;
+    } control;
+
+    msghdr message = msghdr();
+    message.msg_name = sender ? sender->data() : 0;
+    message.msg_namelen = sender ? static_cast<socklen_t>(sender->capacity()) : 0;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof control.buffer;
+
+    ssize_t received;
+    do {
+        received = ::recvmsg(socket.native_handle(), &message, 0);
+    } while (received < 0 && errno == EINTR);
+
+    stamp.nanoseconds = wall_clock_nanoseconds();
+    stamp.kernel = false;
+    if (received < 0) {
+        errorCode = time_service_detail::last_error();
+        return 0;
+    }
+    if (sender) {
+        sender->resize(message.msg_namelen);
+    }
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != 0; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec kernelTime;
+            std::memcpy(&kernelTime, CMSG_DATA(header), sizeof kernelTime);
+            stamp.nanoseconds = int64_t(kernelTime.tv_sec) * 1000000000 + kernelTime.tv_nsec;
+            stamp.kernel = true;
+        }
+    }
+#else
+#if defined(_WIN32)
+    int nameSize = sender ? static_cast<int>(sender->capacity()) : 0;
+    int received = ::recvfrom(socket.native_handle(), static_cast<char*>(buffer.data()), static_cast<int>(buffer.size()),
+                              0, sender ? sender->data() : 0, sender ? &nameSize : 0);
+#else
+    socklen_t nameSize = sender ? static_cast<socklen_t>(sender->capacity()) : 0;
+    ssize_t received;
+    do {
+        received = ::recvfrom(socket.native_handle(), buffer.data(), buffer.size(),
+                              0, sender ? sender->data() : 0, sender ? &nameSize : 0);
+    } while (received < 0 && errno == EINTR);
+#endif
+    stamp.nanoseconds = wall_clock_nanoseconds();
+    stamp.kernel = false;
+    if (received < 0) {
+        errorCode = time_service_detail::last_error();
+        return 0;
+    }
+    if (sender) {
+        sender->resize(static_cast<size_t>(nameSize));
+    }
+#endif
+    errorCode = boost::system::error_code();
+    return static_cast<size_t>(received);
+}
+
+
+// one TCP connection: reads whatever requests arrived, answers them all with one write, reads again
+class TimeServiceConnection : public boost::enable_shared_from_this<TimeServiceConnection>, private boost::noncopyable {
+public:
+    typedef boost::asio::ip::tcp                          tcp;
+    typedef boost::shared_ptr<TimeServiceConnection>      TimeServiceConnectionPtr;
+
+private:
+    tcp::socket                 socket_;
+    bool                        kernelStamps_;
+    std::atomic<uint64_t>&      answered_;
+    std::vector<char>           received_;      // the start of a request that is not complete yet
+    std::vector<TimeReply>      replies_;
+    std::vector<char>           encoded_;
+    char                        readBuffer_[4096];
+
+    void wait_readable()
+    {
+        socket_.async_wait(tcp::socket::wait_read,
+                           METRICS_HANDLER(boost::bind(&TimeServiceConnection::handle_readable, shared_from_this(),
+                                                       boost::asio::placeholders::error)));
+    }
+
+    void handle_readable(const boost::system::error_code& errorCode)
+    {
+        if (errorCode) {
+            return;
+        }
+
+        boost::system::error_code readError;
+        ReceiveStamp stamp;
+        size_t bytes = receive_stamped(socket_, boost::asio::buffer(readBuffer_), static_cast<tcp::endpoint*>(0), stamp, readError);
+        if (readError == boost::asio::error::would_block) {
+            wait_readable();
+            return;
+        }
+        if (readError || bytes == 0) {
+            // closed by the client, or reset: the connection ends with this handler
+            return;
+        }
+
+        received_.insert(received_.end(), readBuffer_, readBuffer_ + bytes);
+        size_t offset = 0;
+        replies_.clear();
+        while (received_.size() - offset >= time_request_size) {
+            TimeRequest request;
+            if (!decode_time_request(&received_[offset], request)) {
+                LOG_WARNING("[time service] WARNING: not a time request, closing the connection\n");
+                return;
+            }
+            TimeReply reply = { request.sequence, stamp.kernel ? uint32_t(time_reply_kernel_receive_stamp) : 0u,
+                                request.clientTransmit, stamp.nanoseconds, 0 };
+            replies_.push_back(reply);
+            offset += time_request_size;
+        }
+        received_.erase(received_.begin(), received_.begin() + offset);
+
+        if (replies_.empty()) {
+            wait_readable();
+            return;
+        }
+
+        // the write goes out right away when the socket buffer has room (async_write tries before it waits)
+        int64_t transmit = wall_clock_nanoseconds();
+        encoded_.resize(replies_.size() * time_reply_size);
+        for (size_t i = 0; i < replies_.size(); ++i) {
+            replies_[i].serverTransmit = transmit;
+            encode_time_reply(replies_[i], &encoded_[i * time_reply_size]);
+            METRICS_RECORD(metric_receive_to_reply, uint64_t(transmit > stamp.nanoseconds ? transmit - stamp.nanoseconds : 0));
+        }
+        boost::asio::async_write(socket_,
+                                 boost::asio::buffer(encoded_),
+                                 METRICS_HANDLER(boost::bind(&TimeServiceConnection::handle_write, shared_from_this(),
+                                                             boost::asio::placeholders::error)));
+    }
+
+    void handle_write(const boost::system::error_code& errorCode)
+    {
+        if (errorCode) {
+            return;
+        }
+        answered_.fetch_add(replies_.size(), std::memory_order_relaxed);
+        wait_readable();
+    }
+
+public:
+    TimeServiceConnection(boost::asio::io_context& io_context, bool kernelStamps, std::atomic<uint64_t>& answered) :
+        socket_(io_context),
+        kernelStamps_(kernelStamps),
+        answered_(answered)
+    {
+    }
+
+    tcp::socket& socket()
+    {
+        return socket_;
+    }
+
+    void start()
+    {
+        boost::system::error_code ignored;
+        socket_.set_option(tcp::no_delay(true), ignored);
+        socket_.non_blocking(true, ignored);
+        if (kernelStamps_) {
+            enable_receive_timestamps(socket_);
+        }
+        wait_readable();
+    }
+};
+
+
+// TCP and UDP on the same port number, on one io_context; kernelStamps = false reads the receive time in
+// user space, after the read, even where the kernel could stamp
+class TimeServiceServer : private boost::noncopyable {
+public:
+    typedef boost::asio::ip::tcp    tcp;
+    typedef boost::asio::ip::udp    udp;
+
+private:
+    boost::asio::io_context&    io_context_;
+    tcp::acceptor               acceptor_;
+    udp::socket                 udpSocket_;
+    bool                        kernelStamps_;
+    std::atomic<uint64_t>       answered_;
+    char                        request_[64];       // larger than a request, to tell a longer datagram apart
+    char                        reply_[time_reply_size];
+
+    void start_accept()
+    {
+        TimeServiceConnection::TimeServiceConnectionPtr connection =
+            boost::make_shared<TimeServiceConnection>(io_context_, kernelStamps_, answered_);
+        acceptor_.async_accept(connection->socket(),
+                               METRICS_HANDLER(boost::bind(&TimeServiceServer::handle_accept, this, connection,
+                                                           boost::asio::placeholders::error)));
+    }
+
+    void handle_accept(TimeServiceConnection::TimeServiceConnectionPtr connection, const boost::system::error_code& errorCode)
+    {
+        if (errorCode == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (!errorCode) {
+            METRICS_COUNT(counter_accepted, 1);
+            connection->start();
+        }
+        start_accept();
+    }
+
+    void wait_udp()
+    {
+        udpSocket_.async_wait(udp::socket::wait_read,
+                              METRICS_HANDLER(boost::bind(&TimeServiceServer::handle_udp_readable, this,
+                                                          boost::asio::placeholders::error)));
+    }
+
+    // answers every datagram that is there, then waits again
+    void handle_udp_readable(const boost::system::error_code& errorCode)
+    {
+        if (errorCode) {
+            return;
+        }
+
+        for (;;) {
+            udp::endpoint sender;
+            ReceiveStamp stamp;
+            boost::system::error_code readError;
+            size_t bytes = receive_stamped(udpSocket_, boost::asio::buffer(request_), &sender, stamp, readError);
+            if (readError) {
+                break;
+            }
+
+            TimeRequest request;
+            if (bytes != time_request_size || !decode_time_request(request_, request)) {
+                continue;
+            }
+
+            TimeReply reply = { request.sequence, stamp.kernel ? uint32_t(time_reply_kernel_receive_stamp) : 0u,
+                                request.clientTransmit, stamp.nanoseconds, wall_clock_nanoseconds() };
+            encode_time_reply(reply, reply_);
+
+            // non-blocking: a reply that does not fit into the send buffer is dropped, the client asks again
+            boost::system::error_code sendError;
+            udpSocket_.send_to(boost::asio::buffer(reply_), sender, 0, sendError);
+            if (!sendError) {
+                answered_.fetch_add(1, std::memory_order_relaxed);
+                METRICS_RECORD(metric_receive_to_reply,
+                               uint64_t(reply.serverTransmit > reply.serverReceive ? reply.serverTransmit - reply.serverReceive : 0));
+            }
+        }
+        wait_udp();
+    }
+
+public:
+    // port 0: the TCP port is picked by the OS, the UDP socket takes the same number
+    TimeServiceServer(boost::asio::io_context& io_context, unsigned short port, bool kernelStamps = true) :
+        io_context_(io_context),
+        acceptor_(io_context),
+        udpSocket_(io_context),
+        kernelStamps_(kernelStamps),
+        answered_(0)
+    {
+        tcp::endpoint endpoint(tcp::v4(), port);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+
+        udp::endpoint udpEndpoint(udp::v4(), acceptor_.local_endpoint().port());
+        udpSocket_.open(udpEndpoint.protocol());
+        udpSocket_.bind(udpEndpoint);
+        udpSocket_.non_blocking(true);
+        if (kernelStamps_) {
+            kernelStamps_ = enable_receive_timestamps(udpSocket_);
+        }
+    }
+
+    void start()
+    {
+        start_accept();
+        wait_udp();
+    }
+
+    unsigned short port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+
+    // whether requests are stamped by the kernel
+    bool kernel_timestamps() const
+    {
+        return kernelStamps_;
+    }
+
+    // may be called from any thread
+    uint64_t answered() const
+    {
+        return answered_.load(std::memory_order_relaxed);
+    }
+};
+
+
+// one exchange, all four timestamps in nanoseconds since the Unix epoch
+struct TimeSample {
+    uint32_t    sequence;
+    int64_t     clientTransmit;
+    int64_t     serverReceive;
+    int64_t     serverTransmit;
+    int64_t     clientReceive;
+    bool        serverKernelStamp;
+    bool        clientKernelStamp;
+
+    int64_t round_trip() const
+    {
+        return (clientReceive - clientTransmit) - (serverTransmit - serverReceive);
+    }
+
+    // how far the server's clock is ahead of ours; off by at most round_trip() / 2
+    int64_t offset() const
+    {
+        return ((serverReceive - clientTransmit) + (serverTransmit - clientReceive)) / 2;
+    }
+
+    // queueing delay and processing time inside the server
+    int64_t server_delay() const
+    {
+        return serverTransmit - serverReceive;
+    }
+};
+
+
+// blocking client, one query at a time; the reply is stamped by the kernel too where it can be
+class TimeServiceClient : private boost::noncopyable {
+public:
+    typedef boost::asio::ip::tcp    tcp;
+    typedef boost::asio::ip::udp    udp;
+
+private:
+    boost::asio::io_context     io_context_;        // never run, sockets only need one to exist
+    TimeServiceTransport        transport_;
+    udp::socket                 udpSocket_;
+    tcp::socket                 tcpSocket_;
+    uint32_t                    sequence_;
+    char                        reply_[64];
+
+    template <typename Socket>
+    void prepare(Socket& socket, std::chrono::milliseconds timeout)
+    {
+        boost::system::error_code errorCode;
+        set_receive_timeout(socket, timeout, errorCode);
+        if (errorCode) {
+            throw boost::system::system_error(errorCode);
+        }
+        enable_receive_timestamps(socket);
+    }
+
+public:
+    TimeServiceClient(const std::string& host, unsigned short port, TimeServiceTransport transport,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) :
+        transport_(transport),
+        udpSocket_(io_context_),
+        tcpSocket_(io_context_),
+        sequence_(0)
+    {
+        if (transport_ == time_service_udp) {
+            udp::resolver resolver(io_context_);
+            udp::resolver::results_type endpoints = resolver.resolve(host, std::to_string(port));
+            boost::asio::connect(udpSocket_, endpoints);
+            prepare(udpSocket_, timeout);
+        }
+        else {
+            tcp::resolver resolver(io_context_);
+            tcp::resolver::results_type endpoints = resolver.resolve(host, std::to_string(port));
+            boost::asio::connect(tcpSocket_, endpoints);
+            tcpSocket_.set_option(tcp::no_delay(true));
+            prepare(tcpSocket_, timeout);
+        }
+    }
+
+    // false with would_block when no reply came within the timeout (UDP: lost; TCP: the connection is
+    // then out of step, make a new client)
+    bool query(TimeSample& sample, boost::system::error_code& errorCode)
+    {
+        TimeRequest request = { ++sequence_, 0 };
+        char encoded[time_request_size];
+        request.clientTransmit = wall_clock_nanoseconds();
+        encode_time_request(request, encoded);
+
+        ReceiveStamp stamp;
+        if (transport_ == time_service_udp) {
+            udpSocket_.send(boost::asio::buffer(encoded), 0, errorCode);
+            if (errorCode) {
+                return false;
+            }
+            // skip late replies to earlier queries
+            TimeReply reply;
+            do {
+                size_t bytes = receive_stamped(udpSocket_, boost::asio::buffer(reply_), static_cast<udp::endpoint*>(0), stamp, errorCode);
+                if (errorCode) {
+                    return false;
+                }
+                if (bytes != time_reply_size || !decode_time_reply(reply_, reply)) {
+                    reply.sequence = request.sequence - 1;
+                }
+            } while (reply.sequence != request.sequence);
+        }
+        else {
+            boost::asio::write(tcpSocket_, boost::asio::buffer(encoded), errorCode);
+            if (errorCode) {
+                return false;
+            }
+            size_t received = 0;
+            while (received < time_reply_size) {
+                size_t bytes = receive_stamped(tcpSocket_, boost::asio::buffer(reply_ + received, time_reply_size - received),
+                                               static_cast<tcp::endpoint*>(0), stamp, errorCode);
+                if (errorCode) {
+                    return false;
+                }
+                if (bytes == 0) {
+                    errorCode = boost::asio::error::eof;
+                    return false;
+                }
+                received += bytes;
+            }
+        }
+
+        TimeReply reply;
+        if (!decode_time_reply(reply_, reply) || reply.sequence != request.sequence) {
+            errorCode = boost::asio::error::invalid_argument;
+            return false;
+        }
+
+        sample.sequence = reply.sequence;
+        sample.clientTransmit = request.clientTransmit;
+        sample.serverReceive = reply.serverReceive;
+        sample.serverTransmit = reply.serverTransmit;
+        sample.clientReceive = stamp.nanoseconds;
+        sample.serverKernelStamp = (reply.flags & time_reply_kernel_receive_stamp) != 0;
+        sample.clientKernelStamp = stamp.kernel;
+        return true;
+    }
+};
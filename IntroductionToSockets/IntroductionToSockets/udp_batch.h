@@ -0,0 +1,180 @@
+#pragma once
+
+// batched datagram I/O on an Asio-managed udp::socket
+
+// on Linux one recvmmsg() / sendmmsg() system call moves a whole batch of datagrams, instead of one
+// receive_from() / send_to() call (and one kernel round trip) per datagram; elsewhere the same interface
+// falls back to a loop of non-blocking receive_from() / send_to() calls
+// the socket must be in non-blocking mode: Asio tells us when it is readable (async_wait), UdpBatch
+// then takes everything that is there, and returns 0 with would_block when the socket is drained
+
+#include <cerrno>
+#include <cstddef>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+
+class UdpBatch {
+public:
+    typedef boost::asio::ip::udp udp;
+
+private:
+    size_t                        batchSize_;
+    size_t                        datagramSize_;
+    std::vector<char>             buffers_;
+    std::vector<size_t>           sizes_;
+    std::vector<udp::endpoint>    endpoints_;       // senders of the received datagrams
+#if defined(__linux__)
+    std::vector<mmsghdr>          headers_;
+    std::vector<iovec>            iovecs_;
+#endif
+
+#if defined(__linux__)
+    static boost::system::error_code last_error()
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return boost::asio::error::would_block;
+        }
+        return boost::system::error_code(errno, boost::system::system_category());
+    }
+
+    // send payload as datagrams [0, count), to the senders of the received datagrams if addressed
+    size_t send_batch(udp::socket& socket, size_t count, boost::asio::const_buffer payload,
+                      bool addressed, boost::system::error_code& errorCode)
+    {
+        count = count < batchSize_ ? count : batchSize_;
+        for (size_t i = 0; i < count; ++i) {
+            iovecs_[i].iov_base = const_cast<void*>(payload.data());
+            iovecs_[i].iov_len = payload.size();
+            headers_[i].msg_hdr.msg_name = addressed ? endpoints_[i].data() : 0;
+            headers_[i].msg_hdr.msg_namelen = addressed ? static_cast<socklen_t>(endpoints_[i].size()) : 0;
+        }
+
+        int sent = ::sendmmsg(socket.native_handle(), &headers_[0], static_cast<unsigned int>(count), MSG_DONTWAIT);
+        if (sent < 0) {
+            errorCode = last_error();
+            return 0;
+        }
+        errorCode = boost::system::error_code();
+        return static_cast<size_t>(sent);
+    }
+#else
+    size_t send_batch(udp::socket& socket, size_t count, boost::asio::const_buffer payload,
+                      bool addressed, boost::system::error_code& errorCode)
+    {
+        count = count < batchSize_ ? count : batchSize_;
+        for (size_t i = 0; i < count; ++i) {
+            if (addressed) {
+                socket.send_to(boost::asio::buffer(payload), endpoints_[i], 0, errorCode);
+            }
+            else {
+                socket.send(boost::asio::buffer(payload), 0, errorCode);
+            }
+            if (errorCode) {
+                return i;
+            }
+        }
+        return count;
+    }
+#endif
+
+public:
+    UdpBatch(size_t batchSize, size_t datagramSize) :
+        batchSize_(batchSize < 1 ? 1 : batchSize),
+        datagramSize_(datagramSize),
+        buffers_(batchSize_ * datagramSize),
+        sizes_(batchSize_),
+        endpoints_(batchSize_)
+#if defined(__linux__)
+        , headers_(batchSize_),
+        iovecs_(batchSize_)
+#endif
+    {
+#if defined(__linux__)
+        for (size_t i = 0; i < batchSize_; ++i) {
+            headers_[i] = mmsghdr();
+            headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+            headers_[i].msg_hdr.msg_iovlen = 1;
+        }
+#endif
+    }
+
+    size_t batch_size() const
+    {
+        return batchSize_;
+    }
+
+    const char* data(size_t i) const
+    {
+        return &buffers_[i * datagramSize_];
+    }
+
+    size_t size(size_t i) const
+    {
+        return sizes_[i];
+    }
+
+    const udp::endpoint& sender(size_t i) const
+    {
+        return endpoints_[i];
+    }
+
+    // receive up to batch_size() datagrams without blocking; 0 with would_block when there are none
+    size_t receive(udp::socket& socket, boost::system::error_code& errorCode)
+    {
+#if defined(__linux__)
+        for (size_t i = 0; i < batchSize_; ++i) {
+            iovecs_[i].iov_base = &buffers_[i * datagramSize_];
+            iovecs_[i].iov_len = datagramSize_;
+            headers_[i].msg_hdr.msg_name = endpoints_[i].data();
+            headers_[i].msg_hdr.msg_namelen = static_cast<socklen_t>(endpoints_[i].capacity());
+        }
+
+        int received = ::recvmmsg(socket.native_handle(), &headers_[0], static_cast<unsigned int>(batchSize_), MSG_DONTWAIT, 0);
+        if (received < 0) {
+            errorCode = last_error();
+            return 0;
+        }
+
+        for (int i = 0; i < received; ++i) {
+            sizes_[i] = headers_[i].msg_len;
+            endpoints_[i].resize(headers_[i].msg_hdr.msg_namelen);
+        }
+        errorCode = boost::system::error_code();
+        return static_cast<size_t>(received);
+#else
+        size_t received = 0;
+        while (received < batchSize_) {
+            sizes_[received] = socket.receive_from(boost::asio::buffer(&buffers_[received * datagramSize_], datagramSize_),
+                                                   endpoints_[received], 0, errorCode);
+            if (errorCode) {
+                break;
+            }
+            ++received;
+        }
+        if (received > 0) {
+            errorCode = boost::system::error_code();
+        }
+        return received;
+#endif
+    }
+
+    // answer the first count received datagrams with the same payload; returns how many were sent,
+    // the rest did not fit into the socket send buffer and are dropped (it is UDP after all)
+    size_t reply(udp::socket& socket, size_t count, boost::asio::const_buffer payload, boost::system::error_code& errorCode)
+    {
+        return send_batch(socket, count, payload, true, errorCode);
+    }
+
+    // send count copies of payload on a connected socket
+    size_t send(udp::socket& socket, size_t count, boost::asio::const_buffer payload, boost::system::error_code& errorCode)
+    {
+        return send_batch(socket, count, payload, false, errorCode);
+    }
+};